@@ -25,10 +25,12 @@ DummyKVOrdered<IO>::get(const char key[], size_t key_size, char *val_buff, size_
 }
 
 template<typename IO>
-int DummyKVOrdered<IO>::generic(int num_op, bool *rw, char *keys, size_t *key_sizes, char **put_values, size_t *put_value_sizes,
-        char *get_buffer,
-        size_t get_buffer_size, size_t *read_values, std::vector<char *> &read_values_ptr) {
+int DummyKVOrdered<IO>::generic(int num_op, bool *rw, uint8_t *flags, char *keys, size_t *key_sizes, char **put_values,
+        size_t *put_value_sizes, std::vector<char> &get_buffer, size_t *read_values,
+        std::vector<char *> &read_values_ptr) {
     int i;
+    *read_values = 0;
+    read_values_ptr.clear();
     for (i = 0; i < num_op; i++) {
 
     }
@@ -36,14 +38,13 @@ int DummyKVOrdered<IO>::generic(int num_op, bool *rw, char *keys, size_t *key_si
 };
 
 template<typename IO>
-int DummyKVOrdered<IO>::put_bulk(size_t numkv, char *k_ptr, size_t *k_sizes, char *v_ptrs, size_t *v_sizes) {
+int DummyKVOrdered<IO>::put_bulk(size_t numkv, char *k_ptr, size_t *k_sizes, char **v_ptrs, size_t *v_sizes) {
     size_t i;
     int rc;
-    char *k = k_ptr, *v = v_ptrs;
+    char *k = k_ptr;
     for (i = 0; i < numkv; i++) {
-        rc = put(k, k_sizes[i], v, v_sizes[i]);
+        rc = put(k, k_sizes[i], v_ptrs[i], v_sizes[i]);
         k += k_sizes[i];
-        v += v_sizes[i];
         if (rc)return rc;
     }
     return 0;
@@ -70,11 +71,22 @@ int DummyKVOrdered<IO>::del(const char key[], size_t key_size) {
     return 0;
 }
 
+template<typename IO>
+int DummyKVOrdered<IO>::clear_range(const char start_key[], size_t start_key_size, size_t max_keys,
+                                    std::string &deleted_keys, std::vector<size_t> &deleted_key_sizes) {
+    return 0;
+}
+
 template<typename IO>
 unsigned long DummyKVOrdered<IO>::get_size() const {
     return keys;
 }
 
+template<typename IO>
+unsigned long DummyKVOrdered<IO>::count_keys(const std::vector<std::string> &boundaries) const {
+    return keys;
+}
+
 template<typename IO>
 unsigned long DummyKVOrdered<IO>::get_raw_capacity() const {
     return 0UL;
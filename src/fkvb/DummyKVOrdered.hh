@@ -34,10 +34,15 @@ public:
 
     int del(const char key[], size_t key_size);
 
-    int put_bulk(size_t numkv, char *k_ptr, size_t *k_sizes, char *v_ptrs, size_t *v_sizes);
+    int clear_range(const char start_key[], size_t start_key_size, size_t max_keys, std::string &deleted_keys,
+                    std::vector<size_t> &deleted_key_sizes);
+
+    int put_bulk(size_t numkv, char *k_ptr, size_t *k_sizes, char **v_ptrs, size_t *v_sizes);
 
     unsigned long get_size() const;
 
+    unsigned long count_keys(const std::vector<std::string> &boundaries) const;
+
     unsigned long get_raw_capacity() const;
 
     void thread_local_entry();
@@ -47,9 +52,9 @@ public:
     int get_range(const char start_key[], size_t start_key_size, const char end_key[], size_t end_key_size,
                   char *kv_buff, size_t kv_buff_size, size_t &kv_size_read, std::vector<char *> &kv_ptrs);
 
-    int generic(int num_op, bool *rw, char *keys, size_t *key_sizes, char **put_values, size_t *put_value_sizes,
-                char *get_buffer,
-                size_t get_buffer_size, size_t *read_values, std::vector<char *> &read_values_ptr);
+    int generic(int num_op, bool *rw, uint8_t *flags, char *keys, size_t *key_sizes, char **put_values,
+                size_t *put_value_sizes, std::vector<char> &get_buffer, size_t *read_values,
+                std::vector<char *> &read_values_ptr);
 
     void print_stats() {
 
@@ -55,12 +55,12 @@
 
 struct io_pattern *init_rnd_gen(std::string *string, fkvb_test_conf *conf, long seed);
 
+static const key_lengths &get_key_lengths(fkvb_test_conf *conf);
+
 double compute_zipf_skew(int access_pct, int address_pct, unsigned long long n);
 
 seed_t get_random_seed();
 
-const char *op_to_string(OPS op);
-
 void signal_barrier(const char *file);
 
 static volatile bool failed = false;
@@ -70,11 +70,21 @@ bool populating = true;
 
 u64 grv_cache_tics_ms=0;
 thread_local uint64_t zrl_fkvb_begin_latency = 0, zrl_fkvb_commit_latency = 0;
+thread_local uint64_t zrl_fkvb_scan_rows = 0, zrl_fkvb_scan_bytes = 0;
+thread_local uint64_t zrl_fkvb_tx_alloc_latency = 0;
+//Accumulated by the backend, drained when samples are recorded
+thread_local uint64_t zrl_fkvb_grv_requests = 0, zrl_fkvb_grv_stale = 0;
+thread_local kv_retry_stats zrl_fkvb_retries;
 thread_local u32 tid;
 u32 sleep_time_us=0;
-
-template<typename IO>
-FKVB<IO>::FKVB(KVOrdered <IO> *_kv, fkvb_test_conf *con) : kv(_kv), conf(con) {
+//All client threads start measuring at start_ticks, which is set by the last thread to reach the start barrier
+static pthread_barrier_t start_barrier;
+static volatile u64 start_ticks = 0;
+static volatile u64 start_wall_usec = 0; //Wall-clock time corresponding to start_ticks
+static u64 start_at_sec = 0;
+
+template<typename IO, typename KeyEncoder>
+FKVB<IO, KeyEncoder>::FKVB(KVOrdered <IO> *_kv, fkvb_test_conf *con) : kv(_kv), conf(con) {
     u32 t = 0;
     population_barrier = conf->load_barrier;
 
@@ -94,8 +104,9 @@ FKVB<IO>::FKVB(KVOrdered <IO> *_kv, fkvb_test_conf *con) : kv(_kv), conf(con) {
         exit(-1);
     }
 
-    grv_cache_tics_ms = conf->grv_cache_ms * (conf->frequency / 1000);
+    grv_cache_tics_ms = (u64) conf->grv_cache_ms * (conf->frequency / 1000);
     sleep_time_us = conf->sleep_time_us;
+    start_at_sec = conf->start_at;
     fprintf(stdout,"grv_cache_tics %lu\n",grv_cache_tics_ms);
     long seed = conf->seed;
     const bool is_population_thread = true;
@@ -112,8 +123,8 @@ FKVB<IO>::FKVB(KVOrdered <IO> *_kv, fkvb_test_conf *con) : kv(_kv), conf(con) {
     }
 }
 
-template<typename IO>
-int FKVB<IO>::do_read(fkvb_thread_state *state) {
+template<typename IO, typename KeyEncoder>
+int FKVB<IO, KeyEncoder>::do_read(fkvb_thread_state *state) {
     THREAD_TRACE("%s", "Doing a read");
     size_t key_size, val_size_read, val_size;
     const size_t val_buffer_size = state->buffer_size_value;
@@ -140,9 +151,9 @@ int FKVB<IO>::do_read(fkvb_thread_state *state) {
 }
 
 
-template<typename IO>
-int FKVB<IO>::do_scan(fkvb_thread_state *state) {
-    size_t key_size, val_size_read;
+template<typename IO, typename KeyEncoder>
+int FKVB<IO, KeyEncoder>::do_scan(fkvb_thread_state *state) {
+    size_t key_size, end_key_size, val_size_read;
     const size_t val_buffer_size = state->buffer_size_value;
 
     char *start_key = state->key_buffer, *end_key = state->key_buffer2;
@@ -158,11 +169,14 @@ int FKVB<IO>::do_scan(fkvb_thread_state *state) {
 
     //Pick actual key
     state->key_builder->build(next_key_index, start_key, &key_size);
-    state->key_builder->build(end_key_index, end_key, &key_size);
+    state->key_builder->build(end_key_index, end_key, &end_key_size);
 
-    if (strcmp(start_key, end_key) > 0) {
+    //Keys are binary and not NUL-terminated, and can have different sizes
+    const int cmp = memcmp(start_key, end_key, std::min(key_size, end_key_size));
+    if (cmp > 0 || (cmp == 0 && key_size > end_key_size)) {
         beg = end_key;
         end = start_key;
+        std::swap(key_size, end_key_size);
     } else {
         end = end_key;
         beg = start_key;
@@ -172,13 +186,15 @@ int FKVB<IO>::do_scan(fkvb_thread_state *state) {
     //do op
     START_TIMER(state);
     std::vector<char *> kv_ptrs = std::vector<char *>();
+    zrl_fkvb_scan_rows = zrl_fkvb_scan_bytes = 0;
 
     Y_PROBE_TICKS_START(do_range);
-    rc = state->kv->get_range(beg, key_size, end, key_size, values,
+    rc = state->kv->get_range(beg, key_size, end, end_key_size, values,
                               val_buffer_size, val_size_read, kv_ptrs);
     Y_PROBE_TICKS_END(do_range);
     END_TIMER
     (state);
+    state->xput_stats->add_scan_sample(zrl_fkvb_scan_rows, zrl_fkvb_scan_bytes);
     THREAD_TRACE("Scan done. Time taken %"
                          P64
                          " nsec", time);
@@ -186,22 +202,35 @@ int FKVB<IO>::do_scan(fkvb_thread_state *state) {
 }
 
 
-template<typename IO>
 /*
- * Right now the easiest way to plug this in is to just pass the keys we want to read and write
- * and let the kv define a proper operation.
- * This means we cannot have a proper business logic in the tx: we just do operations, but that's not a big deal now
+ * Picks the keys of a generic transaction, whether each of them is read or written, and its options.
+ * Written values are not copied: put_ptr points to the values generated by the value builder (or to the operand, for
+ * atomic mutations)
  */
-int FKVB<IO>::do_generic(fkvb_thread_state *state) {
+template<typename IO, typename KeyEncoder>
+void FKVB<IO, KeyEncoder>::build_generic(fkvb_thread_state *state, char *keys, size_t *key_sizes, bool *rw,
+                                         u8 *flags, char **put_ptr, size_t *value_sizes) {
     u32 op = 0;
     u32 curr_w = 0;
-    char *curr_key = state->generic_key_buffer, *curr_put_value = state->generic_putvalue_buffer;
-    size_t *curr_key_size = state->generic_key_sizes, *curr_value_size = state->generic_value_sizes;
-    bool *rw = state->generic_rw;
+    char *curr_key = keys, *curr_put_value;
+    size_t *curr_key_size = key_sizes, *curr_value_size = value_sizes;
 
-    const size_t value_sizes = state->value_builder->next_size();
     while (op < state->generic_ops) {
-        const int next_key_index = state->key_index_generator->next();
+        rw[op] = state->secondary_next_op_generator->next() == OP_UPDATE;
+        flags[op] = 0;
+        if (state->options_rnd) {
+            if ((u8) state->options_rnd->next() < (rw[op] ? state->no_conflict_perc : state->snapshot_perc)) {
+                flags[op] |= KV_OP_NO_CONFLICT;
+            }
+            if ((u8) state->options_rnd->next() < state->conflict_perc) {
+                flags[op] |= KV_OP_ADD_CONFLICT;
+            }
+            if (rw[op] && (u8) state->options_rnd->next() < state->atomic_perc) {
+                flags[op] |= KV_OP_ATOMIC;
+            }
+        }
+        const int next_key_index = (flags[op] & KV_OP_ATOMIC) && state->atomic_key_generator ?
+                                   state->atomic_key_generator->next() : state->key_index_generator->next();
 
         //Pick actual key
         state->key_builder->build(next_key_index, curr_key, &curr_key_size[op]);
@@ -209,37 +238,189 @@ int FKVB<IO>::do_generic(fkvb_thread_state *state) {
         curr_key += curr_key_size[op];
 
 
-        if (state->secondary_next_op_generator->next() == OP_UPDATE) { //Pick value to put
-            rw[op] = true;
-            curr_put_value = (char *) state->value_builder->_build(&curr_value_size[curr_w]);
-            state->generic_put_ptr[curr_w] = curr_put_value;
+        if (rw[op]) { //Pick value to put
+            if (flags[op] & KV_OP_ATOMIC) {
+                curr_put_value = state->atomic_operand;
+                curr_value_size[curr_w] = state->atomic_size;
+            } else {
+                curr_put_value = (char *) state->value_builder->_build(&curr_value_size[curr_w]);
+            }
+            put_ptr[curr_w] = curr_put_value;
             //curr_put_value += curr_value_size[curr_w];
             THREAD_TRACE("Generic put on key %.*s: (%p) value %.*s length %zu",
                          (int) curr_key_size[op], (curr_key - curr_key_size[op]),
                          curr_put_value, (int) curr_value_size[curr_w],
-                         state->generic_put_ptr[curr_w], curr_value_size[curr_w]);
+                         put_ptr[curr_w], curr_value_size[curr_w]);
             curr_w++;
-        } else {
-            rw[op] = false;
         }
         op++;
     }
-    std::vector<char *> vect;
-    size_t get_buff_size = value_sizes * state->generic_ops;
+}
+
+template<typename IO, typename KeyEncoder>
+/*
+ * Right now the easiest way to plug this in is to just pass the keys we want to read and write
+ * and let the kv define a proper operation.
+ * This means we cannot have a proper business logic in the tx: we just do operations, but that's not a big deal now
+ */
+int FKVB<IO, KeyEncoder>::do_generic(fkvb_thread_state *state) {
+    build_generic(state, state->generic_key_buffer, state->generic_key_sizes, state->generic_rw,
+                  state->generic_flags, state->generic_put_ptr, state->generic_value_sizes);
     size_t size_read;
     int rc;
 
     Y_PROBE_TICKS_START(do_generic);
-    rc = state->kv->generic(state->generic_ops, state->generic_rw, state->generic_key_buffer,
+    rc = state->kv->generic(state->generic_ops, state->generic_rw, state->generic_flags, state->generic_key_buffer,
                             state->generic_key_sizes,
                             state->generic_put_ptr, state->generic_value_sizes,
-                            state->generic_getvalue_buffer, get_buff_size, &size_read, vect);
+                            state->generic_get_buffer, &size_read, state->generic_read_ptrs);
     Y_PROBE_TICKS_END(do_generic);
     return rc;
 }
 
-template<typename IO>
-int FKVB<IO>::do_update(fkvb_thread_state *state) {
+//Single atomic mutation, run as a generic transaction of one op
+template<typename IO, typename KeyEncoder>
+int FKVB<IO, KeyEncoder>::do_atomic(fkvb_thread_state *state) {
+    THREAD_TRACE("%s", "Doing an atomic op");
+    size_t key_size, size_read;
+    bool rw = true;
+    u8 flags = KV_OP_ATOMIC;
+    std::vector<char *> vect;
+    int rc;
+    char *key = state->key_buffer;
+    //Pick key number
+    const int next_key_index = state->atomic_key_generator ? state->atomic_key_generator->next() :
+                               state->key_index_generator->next();
+    THREAD_TRACE("Next key index %u", next_key_index);
+
+    //Pick actual key
+    state->key_builder->build(next_key_index, key, &key_size);
+
+    //do op
+    START_TIMER(state);
+    Y_PROBE_TICKS_START(do_atomic);
+    rc = state->kv->generic(1, &rw, &flags, key, &key_size, &state->atomic_operand, &state->atomic_size,
+                            state->generic_get_buffer, &size_read, vect);
+    Y_PROBE_TICKS_END(do_atomic);
+    END_TIMER(state);
+    return rc;
+}
+
+template<typename IO, typename KeyEncoder>
+int FKVB<IO, KeyEncoder>::do_delete(fkvb_thread_state *state) {
+    THREAD_TRACE("%s", "Doing a delete");
+    size_t key_size;
+    int rc;
+    char *key = state->key_buffer;
+    //Pick key number
+    const int next_key_index = state->key_index_generator->next();
+    THREAD_TRACE("Next key index %u", next_key_index);
+
+    //Pick actual key
+    state->key_builder->build(next_key_index, key, &key_size);
+
+    //do op
+    START_TIMER(state);
+    Y_PROBE_TICKS_START(do_delete);
+    rc = state->kv->del(key, key_size);
+    Y_PROBE_TICKS_END(do_delete);
+    END_TIMER(state);
+    //A clear does not tell if the key was there: it is counted and inserted back anyway (inserting it is idempotent)
+    if (!rc) {
+        state->deleted.push_back({state->ops_done + state->reinsert_delay, std::string(key, key_size)});
+        state->xput_stats->add_delete_sample(1, 0);
+    }
+    return rc;
+}
+
+//Deletes the keys from a random one on, as many as drawn from --clear_range_len
+template<typename IO, typename KeyEncoder>
+int FKVB<IO, KeyEncoder>::do_clear_range(fkvb_thread_state *state) {
+    THREAD_TRACE("%s", "Doing a clear range");
+    size_t key_size, i;
+    int rc;
+    char *key = state->key_buffer;
+    const size_t length = state->clear_range_length_generator->next();
+    //Pick key number
+    const int next_key_index = state->key_index_generator->next();
+    THREAD_TRACE("Next key index %u, clearing %zu keys", next_key_index, length);
+
+    //Pick actual key
+    state->key_builder->build(next_key_index, key, &key_size);
+
+    //do op
+    std::string keys;
+    std::vector<size_t> key_sizes;
+    START_TIMER(state);
+    Y_PROBE_TICKS_START(do_clear_range);
+    rc = state->kv->clear_range(key, key_size, length, keys, key_sizes);
+    Y_PROBE_TICKS_END(do_clear_range);
+    END_TIMER(state);
+    if (!rc) {
+        const char *k = keys.data();
+        for (i = 0; i < key_sizes.size(); i++) {
+            state->deleted.push_back({state->ops_done + state->reinsert_delay, std::string(k, key_sizes[i])});
+            k += key_sizes[i];
+        }
+        state->xput_stats->add_delete_sample(key_sizes.size(), 0);
+    }
+    return rc;
+}
+
+/*
+ * Inserts back, in one transaction, the keys deleted by the thread at least reinsert_delay ops ago, or all of them
+ * (at most REINSERT_MAX_KEYS), so that deletes do not drain the key space
+ */
+#define REINSERT_MAX_KEYS 1000
+template<typename IO, typename KeyEncoder>
+int FKVB<IO, KeyEncoder>::do_reinsert(fkvb_thread_state *state, bool all) {
+    THREAD_TRACE("%s", "Inserting back deleted keys");
+    size_t n = 0;
+    int rc;
+    state->reinsert_keys.clear();
+    state->reinsert_key_sizes.clear();
+    state->reinsert_value_sizes.clear();
+    state->reinsert_values.clear();
+    while (!state->deleted.empty() && (all || state->deleted.front().due <= state->ops_done) && n < REINSERT_MAX_KEYS) {
+        size_t value_size;
+        const std::string &key = state->deleted.front().key;
+        state->reinsert_keys.append(key);
+        state->reinsert_key_sizes.push_back(key.size());
+        state->reinsert_values.push_back((char *) state->value_builder->_build(&value_size));
+        state->reinsert_value_sizes.push_back(value_size);
+        state->deleted.pop_front();
+        n++;
+    }
+
+    //Not an op of the mix: only the number of keys is recorded
+    Y_PROBE_TICKS_START(do_reinsert);
+    rc = state->kv->put_bulk(n, &state->reinsert_keys[0], &state->reinsert_key_sizes[0], &state->reinsert_values[0],
+                             &state->reinsert_value_sizes[0]);
+    Y_PROBE_TICKS_END(do_reinsert);
+    if (!rc) {
+        state->xput_stats->add_delete_sample(0, n);
+    }
+    return rc;
+}
+
+/*
+ * Inserts back the deleted keys that are due, or all of them at the end of the test. This runs between the ops of the
+ * thread, so it does not count as an op, does not take an arrival in open loop, and is not in the latency of any op
+ */
+template<typename IO, typename KeyEncoder>
+void FKVB<IO, KeyEncoder>::reinsert_deleted(fkvb_thread_state *state, bool all) {
+    while (!state->deleted.empty() && (all || state->deleted.front().due <= state->ops_done)) {
+        const int rc = do_reinsert(state, all);
+        if (rc) {
+            ERROR("DO_REINSERT FAILED with code %d", rc);
+            failed = true;
+            return;
+        }
+    }
+}
+
+template<typename IO, typename KeyEncoder>
+int FKVB<IO, KeyEncoder>::do_update(fkvb_thread_state *state) {
     THREAD_TRACE("%s", "Doing an update");
     const char *value_ptr;
     size_t key_size;
@@ -270,8 +451,8 @@ int FKVB<IO>::do_update(fkvb_thread_state *state) {
 
 }
 
-template<typename IO>
-int FKVB<IO>::do_insert(fkvb_thread_state *state) {
+template<typename IO, typename KeyEncoder>
+int FKVB<IO, KeyEncoder>::do_insert(fkvb_thread_state *state) {
     THREAD_TRACE("%s", "Doing an insert (update)");
     size_t key_size;
     const char *value_ptr;
@@ -306,34 +487,64 @@ int FKVB<IO>::do_insert(fkvb_thread_state *state) {
 }
 
 
-template<typename IO>
-int FKVB<IO>::do_populate_bulk(fkvb_thread_state *state, u32 ops) {
-    unsigned int i;
+/*
+ * Fills a bulk insert with the next keys of the thread, up to max_keys keys or until the keys and values reach
+ * max_bytes. Values are not copied: they point to the random buffer of the value builder
+ */
+template<typename IO, typename KeyEncoder>
+void FKVB<IO, KeyEncoder>::build_bulk(fkvb_thread_state *state, struct bulk_batch *b, u32 max_keys, u64 max_bytes) {
+    char *key = b->keys;
+    b->num_keys = 0;
+    b->bytes = 0;
+    while (b->num_keys < max_keys && b->bytes < max_bytes) {
+        const u32 i = b->num_keys;
+        const int next_key_index = state->key_index_generator->next();
+        state->key_builder->build(next_key_index, key, &b->key_sizes[i]);
+        THREAD_TRACE("POP: NEXT KEY %u  %.*s %d", next_key_index, (int) (b->key_sizes[i]), key,
+                     (int) (b->key_sizes[i]));
+        b->values[i] = (char *) state->value_builder->_build(&b->value_sizes[i]);
+        b->bytes += b->key_sizes[i] + b->value_sizes[i];
+        key += b->key_sizes[i];
+        b->num_keys++;
+    }
+}
+
+template<typename IO, typename KeyEncoder>
+int FKVB<IO, KeyEncoder>::do_populate_bulk(fkvb_thread_state *state, struct bulk_batch *b) {
     int rc;
-    int next_key_index;
-    char *key = state->key_buffer_bulk;
-    char *value_ptr = state->value_buffer_bulk;
     tid = state->id;
-    for (i = 0; i < ops; i++) {
-        next_key_index = state->key_index_generator->next();
-        state->key_builder->build(next_key_index, key, &state->key_sizes_bulk[i]);
-        THREAD_TRACE("POP: NEXT KEY %u  %.*s %d", next_key_index, (int) (state->key_sizes_bulk[i]), key,
-                     (int) (state->key_sizes_bulk[i]));
-        key += state->key_sizes_bulk[i];
-        state->value_builder->build(value_ptr, &state->value_sizes_bulk[i]);
-        value_ptr += state->value_sizes_bulk[i];
-    }
     START_TIMER(state);
     Y_PROBE_TICKS_START(do_populate);
-    rc = state->kv->put_bulk((size_t) BULK_SIZE, state->key_buffer_bulk, &state->key_sizes_bulk[0],
-                             state->value_buffer_bulk, &state->value_sizes_bulk[0]);
+    rc = state->kv->put_bulk((size_t) b->num_keys, b->keys, b->key_sizes, b->values, b->value_sizes);
     Y_PROBE_TICKS_END(do_populate);
     END_TIMER(state);
     return rc;
 }
 
-template<typename IO>
-int FKVB<IO>::do_populate(fkvb_thread_state *state) {
+/*
+ * Records a completed bulk insert, whose start and duration are in state->last_init and state->last_duration.
+ * We need that #samples is the number of keys so that we can double check the load phase, so we add a sample for
+ * each key written. The time of an op in a bulk insert is the time of the bulk insert divided by the number of keys
+ */
+template<typename IO, typename KeyEncoder>
+void FKVB<IO, KeyEncoder>::record_bulk(fkvb_thread_state *state, struct bulk_batch *b, kv_retry_stats &retries) {
+    u32 i;
+    for (i = 0; i < b->num_keys; i++) {
+        //NOTE: this is done within a loop. This means that one op can belong
+        //To one epoch, and one to another epoch (if the bulk happens across two epochs)
+        //This is why sometimes we get odd values as xput in loading ;)
+        state->add_sample(state->last_duration / b->num_keys, state->last_init, state->last_op);
+    }
+    state->add_retry_sample(retries);
+    state->xput_stats->add_grv_sample(zrl_fkvb_grv_requests, zrl_fkvb_grv_stale);
+    zrl_fkvb_grv_requests = zrl_fkvb_grv_stale = 0;
+    state->xput_stats->add_load_sample(b->bytes);
+    state->loaded_keys += b->num_keys;
+    state->loaded_bytes += b->bytes;
+}
+
+template<typename IO, typename KeyEncoder>
+int FKVB<IO, KeyEncoder>::do_populate(fkvb_thread_state *state) {
     THREAD_TRACE("%s", "Doing an insert (update)");
     size_t key_size;
     tid = state->id;
@@ -361,6 +572,9 @@ int FKVB<IO>::do_populate(fkvb_thread_state *state) {
     rc = state->kv->put(key, key_size, value_ptr, state->buffer_size_value);
     Y_PROBE_TICKS_END(do_populate);
     END_TIMER(state);
+    state->xput_stats->add_load_sample(key_size + state->buffer_size_value);
+    state->loaded_keys++;
+    state->loaded_bytes += key_size + state->buffer_size_value;
     THREAD_TRACE("Written %s. Time taken %"
                          P64
                          " nsec", state->value_buffer, time);
@@ -368,8 +582,8 @@ int FKVB<IO>::do_populate(fkvb_thread_state *state) {
 
 }
 
-template<typename IO>
-int FKVB<IO>::do_rmw(fkvb_thread_state *state) {
+template<typename IO, typename KeyEncoder>
+int FKVB<IO, KeyEncoder>::do_rmw(fkvb_thread_state *state) {
     THREAD_TRACE("%s", "Doing a rmw");
     size_t key_size, val_size_read, val_size;
     int rc;
@@ -405,10 +619,10 @@ int FKVB<IO>::do_rmw(fkvb_thread_state *state) {
 
 #include <bitset>
 
-template<typename IO>
+template<typename IO, typename KeyEncoder>
 void
-FKVB<IO>::init_state(struct fkvb_thread_state *state, fkvb_test_conf *conf, KVOrdered <IO> *kv, u32 id, long seed,
-                     bool populate) {
+FKVB<IO, KeyEncoder>::init_state(struct fkvb_thread_state *state, fkvb_test_conf *conf, KVOrdered <IO> *kv, u32 id,
+                                 long seed, bool populate) {
 
     state->id = id;
     state->num_keys = conf->num_keys;
@@ -470,13 +684,13 @@ FKVB<IO>::init_state(struct fkvb_thread_state *state, fkvb_test_conf *conf, KVOr
         }
     }
 
+    //The factory has picked the KeyEncoder of the key type
     if (conf->key_type == "fkvb") {
         if (!state->id)PRINT_FORMAT("\n------  PREFIX KEYS v-------\n");
-        state->key_builder = new prefix_key_string_builder(nullptr, (size_t) conf->key_size, conf->num_keys);
+        state->key_builder = KeyEncoder::create(get_key_lengths(conf), conf->num_keys, nullptr);
     } else if (conf->key_type == "random") {
         if (!state->id) PRINT_FORMAT("\n------  RND KEYS v-------\n");
-        state->key_builder = new key_string_builder_rnd(new rand_io_pattern(250, 0), (size_t) conf->key_size,
-                                                        conf->num_keys);
+        state->key_builder = KeyEncoder::create(get_key_lengths(conf), conf->num_keys, nullptr);
     } else {
 
         int th = populate ? conf->num_population_threads : conf->thread_nr_m;
@@ -508,12 +722,10 @@ FKVB<IO>::init_state(struct fkvb_thread_state *state, fkvb_test_conf *conf, KVOr
         std::string ref = std::string((char *) &shard, sizeof(size_t));
         if (conf->key_type == "sharded_fkvb") {
             if (!state->id) PRINT_FORMAT("\n------  SHARDED FKVB  KEYS v-------\n");
-            state->key_builder = new prefix_key_string_builder(nullptr, (size_t) conf->key_size, conf->num_keys, ref);
         } else {
             if (!state->id) PRINT_FORMAT("\n------  SHARDED  RND KEYS v-------\n");
-            state->key_builder = new prefix_key_string_builder_rnd(new rand_io_pattern(250, 0), (size_t) conf->key_size,
-                                                                   conf->num_keys, ref);
         }
+        state->key_builder = KeyEncoder::create(get_key_lengths(conf), conf->num_keys, &ref);
 #if 1
         printf("SHARD: %zu\n", shard);
         std::cout << "c = " << std::bitset<64>(shard) << std::endl;
@@ -524,13 +736,12 @@ FKVB<IO>::init_state(struct fkvb_thread_state *state, fkvb_test_conf *conf, KVOr
             printf("%*.s %d = %hu %c\n", (int) sizeof(size_t), ref.c_str(), s, c, c);
         }
         size_t ss;
-        assert(conf->key_size < 4096);
-        char t[4096];
+        char t[KEY_BUFFER_SIZE];
         for (s = 0; s < 10; s++) {
             unsigned cc;
             state->key_builder->build(s, t, &ss);
-            printf("%u %u = %.*s\n", conf->instance_id, state->id, conf->key_size, t);
-            for (cc = 0; cc < conf->key_size; cc++) {
+            printf("%u %u = %.*s\n", conf->instance_id, state->id, (int) ss, t);
+            for (cc = 0; cc < ss; cc++) {
                 unsigned char c = (unsigned char) (t[cc]);
                 printf("%hu.", c);
             }
@@ -572,9 +783,59 @@ FKVB<IO>::init_state(struct fkvb_thread_state *state, fkvb_test_conf *conf, KVOr
         state->next_op_generator->add_ops(OP_RMW, conf->insert_perc);
     }
 
+    //Open loop: the aggregate rate is split evenly across the threads of the process
+    if (!populate && conf->target_rate) {
+        const double rate = (double) conf->target_rate / (double) conf->thread_nr_m;
+        state->arrival = new arrival_pattern(rate, conf->frequency, conf->arrival == "poisson", (long) rnd.next());
+        if (!state->id) PRINT_FORMAT("Open loop: %f tx/s per thread with %s arrivals", rate, conf->arrival.c_str());
+    }
+
     //Value
-    state->value_builder = new value_string_builder_rnd(init_rnd_gen(&conf->value_size_gen, conf, seed));
-    //TODO: Add a check such that the largest value fits within the buffer
+    const value_pool &pool = value_pool::shared(conf->value_compression);
+    state->value_builder = new value_string_builder_rnd(init_rnd_gen(&conf->value_size_gen, conf, seed), pool,
+                                                        (u64) seed);
+    if (state->value_builder->_pattern->_end >= pool.size) {
+        FATAL("Values of up to %zu bytes do not fit in the value pool (%zu bytes)", state->value_builder->_pattern->_end,
+              pool.size);
+    }
+
+    //Deletes. Deleted keys are inserted back by the same thread
+    if (!populate && (conf->delete_perc || conf->clear_range_perc)) {
+        state->reinsert_delay = conf->reinsert_delay;
+        if (conf->delete_perc) {
+            state->next_op_generator->add_ops(OP_DELETE, conf->delete_perc);
+        }
+        if (conf->clear_range_perc) {
+            state->clear_range_length_generator = init_rnd_gen(&conf->clear_range_len_gen, conf, (long) rnd.next());
+            if (state->clear_range_length_generator == nullptr) {
+                exit(1);
+            }
+            state->next_op_generator->add_ops(OP_CLEAR_RANGE, conf->clear_range_perc);
+        }
+    }
+
+    //Atomic mutations
+    if (!populate && (conf->atomic_perc || (conf->generic_perc && conf->generic_atomic_perc))) {
+        state->atomic_size = conf->atomic_size;
+        state->atomic_operand = (char *) malloc(state->atomic_size);
+        if (state->atomic_operand == nullptr) {
+            FATAL("Error in building the operand of atomic ops");
+        }
+        if (conf->atomic_op == "add") {
+            memset(state->atomic_operand, 0, state->atomic_size);
+            state->atomic_operand[0] = 1;
+        } else {
+            for (size_t b = 0; b < state->atomic_size; b++) {
+                state->atomic_operand[b] = (char) rnd.next();
+            }
+        }
+        if (conf->atomic_keys) {
+            state->atomic_key_generator = new rand_io_pattern(conf->atomic_keys, 0, (long) rnd.next());
+        }
+        if (conf->atomic_perc) {
+            state->next_op_generator->add_ops(OP_ATOMIC, conf->atomic_perc);
+        }
+    }
 
     //KV
     state->kv = kv;
@@ -586,10 +847,6 @@ FKVB<IO>::init_state(struct fkvb_thread_state *state, fkvb_test_conf *conf, KVOr
 
     //TO BE DONE AFTER INITIALIZING THE VALUE BUILDER, BC  WE NEED THAT SIZE
     if (conf->generic_perc) {
-        if (state->value_builder->_pattern->_beg != state->value_builder->_pattern->_end) {
-            FATAL("Right now, generic ops only work with values of constant size.");
-            //Can we get around this by simply using the "_end" size to (over)provision the buffers?
-        }
         state->next_op_generator->add_ops(OP_GENERIC, conf->generic_perc);
         state->secondary_next_op_generator = new next_op_pattern((long) rnd.next());
         state->secondary_next_op_generator->add_ops(OP_READ, conf->generic_rp);
@@ -600,21 +857,41 @@ FKVB<IO>::init_state(struct fkvb_thread_state *state, fkvb_test_conf *conf, KVOr
                              " with %"
                              P8
                              " read percentage", conf->generic_perc, conf->generic_rp);
-        state->generic_key_buffer = (char *) malloc(state->generic_ops * conf->key_size);
-        state->generic_putvalue_buffer = (char *) malloc(state->generic_ops * state->value_builder->next_size());
-        state->generic_getvalue_buffer = (char *) malloc(state->generic_ops * state->value_builder->next_size());
+        state->generic_key_buffer = (char *) malloc(state->generic_ops * get_key_lengths(conf).max_size);
+        //Written values are not copied. The values read are: room for the largest value, then grown on demand
+        state->generic_get_buffer.resize(state->value_builder->_pattern->_end);
+        state->generic_read_ptrs.reserve(state->generic_ops);
         state->generic_rw = (bool *) malloc(state->generic_ops * sizeof(bool));
+        state->generic_flags = (u8 *) malloc(state->generic_ops * sizeof(u8));
         state->generic_key_sizes = (size_t *) malloc(state->generic_ops * sizeof(size_t));
         state->generic_value_sizes = (size_t *) malloc(state->generic_ops * sizeof(size_t));
         state->generic_get_ptr = (char **) malloc(state->generic_ops * sizeof(char *));
         state->generic_put_ptr = (char **) malloc(state->generic_ops * sizeof(char *));
 
-        if (state->generic_key_buffer == nullptr || state->generic_putvalue_buffer == nullptr ||
-            state->generic_getvalue_buffer == nullptr || state->generic_rw == nullptr ||
+        if (state->generic_key_buffer == nullptr || state->generic_rw == nullptr || state->generic_flags == nullptr ||
             state->generic_key_sizes == nullptr || state->generic_value_sizes == nullptr ||
             state->generic_put_ptr == nullptr || state->generic_get_ptr == nullptr) {
             FATAL("Error in building buffers for generic ops");
         }
+        if (conf->generic_snapshot_perc || conf->generic_no_conflict_perc || conf->generic_conflict_perc ||
+            conf->generic_atomic_perc) {
+            state->options_rnd = new rand_io_pattern(100, 0, (long) rnd.next());
+            state->snapshot_perc = conf->generic_snapshot_perc;
+            state->no_conflict_perc = conf->generic_no_conflict_perc;
+            state->conflict_perc = conf->generic_conflict_perc;
+            state->atomic_perc = conf->generic_atomic_perc;
+        }
+        if (!populate && conf->tx_in_flight > 1) {
+            state->async = new async_engine(conf->tx_in_flight, state->generic_ops,
+                                            get_key_lengths(conf).max_size);
+            if (!state->id) PRINT_FORMAT("Each thread keeps %u transactions in flight", conf->tx_in_flight);
+        }
+    }
+
+    if (populate && (conf->bulk_keys > 1 || conf->bulk_bytes)) {
+        const size_t min_record = get_key_lengths(conf).min_size + state->value_builder->_pattern->_beg;
+        state->bulk = new bulk_engine(conf->bulk_in_flight, conf->bulk_keys, conf->bulk_bytes,
+                                      min_record ? min_record : 1, get_key_lengths(conf).max_size);
     }
 
 }
@@ -647,7 +924,7 @@ struct io_pattern *init_rnd_gen(std::string *string, fkvb_test_conf *conf, long
                 FATAL("Pattern %s has min  > max", pattern);
             }
             TRACE_FORMAT("Bounded uniform distr: %s with params %u %u", pattern, lower, higher);
-            return new rand_io_pattern(lower, higher, seed);
+            return new rand_io_pattern(higher + 1, lower, seed); //Both bounds included
         }
     } else if (0 == string->compare(0, strlen(ZIPFIAN), ZIPFIAN)) {//Zipfian is only for the dap. #key param is implicit
         unsigned int hot = 0;
@@ -690,18 +967,112 @@ struct io_pattern *init_rnd_gen(std::string *string, fkvb_test_conf *conf, long
     }
 }
 
-template<typename IO>
-void *FKVB<IO>::tx_loop(void *_state) {
+/*
+ * Distribution of the key sizes (--key_size). Besides constx and uniformx_y, zipfx_y gives sizes in [x, y] where the
+ * smaller ones are more frequent (the zipf of the DAP is over the key indexes, so it is not used here)
+ */
+static struct io_pattern *init_key_size_gen(fkvb_test_conf *conf, long seed) {
+    if (0 == conf->key_size_gen.compare(0, strlen(ZIPFIAN), ZIPFIAN)) {
+        unsigned int lower = 0;
+        unsigned int higher = 0;
+        unsigned bytes = 0;
+        const char *pattern = conf->key_size_gen.c_str();
+        unsigned count = sscanf(pattern, ZIPFIAN "%u_%u%n", &lower, &higher, &bytes);
+        if (count != 2 || bytes != strlen(pattern) || lower > higher) {
+            FATAL("Error in parsing a zipfian key size distr: %s. Format is %s%%d_%%d, with min <= max", pattern,
+                  ZIPFIAN);
+        }
+        return new zipf_io_pattern(higher + 1, lower, KEY_SIZE_ZIPF_SKEW, seed);
+    }
+    return init_rnd_gen(&conf->key_size_gen, conf, seed);
+}
+
+//Key sizes of --key_size: one table per process, shared by the key encoders of all threads
+static const key_lengths &get_key_lengths(fkvb_test_conf *conf) {
+    static const key_lengths lengths(init_key_size_gen(conf, (long) KEY_LENGTH_SEED));
+    if (lengths.max_size > KEY_BUFFER_SIZE) {
+        FATAL("Keys of up to %zu bytes do not fit in the key buffers (%lu bytes)", lengths.max_size, KEY_BUFFER_SIZE);
+    }
+    return lengths;
+}
+
+/*
+ * Start barrier of the client threads. The last thread to arrive computes the start tick: either now, or the tick
+ * corresponding to the wall-clock time given with --start_at, so that processes on the same host start together.
+ * Then, every thread waits until that tick
+ */
+template<typename IO, typename KeyEncoder>
+void FKVB<IO, KeyEncoder>::wait_start(fkvb_thread_state *state) {
+    const int rc = pthread_barrier_wait(&start_barrier);
+    if (rc == PTHREAD_BARRIER_SERIAL_THREAD) {
+        const u64 now = ticks::get_ticks();
+        const u64 now_usec = state->op_timer->t_long_usec();
+        u64 start = now, start_usec = now_usec;
+        if (start_at_sec) {
+            if (start_at_sec * 1000000 > now_usec) {
+                start = now + (start_at_sec * 1000000 - now_usec) * state->op_timer->tics_per_usec;
+                start_usec = start_at_sec * 1000000;
+            } else {
+                PRINT_FORMAT("WARNING: start time %lu is in the past (now is %lu usec). Starting right away",
+                             start_at_sec, now_usec);
+            }
+        }
+        start_ticks = start;
+        start_wall_usec = start_usec;
+        PRINT_FORMAT("Client threads start in %lu usec", (start - now) / state->op_timer->tics_per_usec);
+    } else if (rc) {
+        FATAL("Error %d in waiting on the start barrier", rc);
+    }
+    //Make sure every thread sees start_ticks
+    pthread_barrier_wait(&start_barrier);
+    u64 now = ticks::get_ticks();
+    while (now < start_ticks) {
+        const u64 slack_us = (start_ticks - now) / state->op_timer->tics_per_usec;
+        if (slack_us > ARRIVAL_SPIN_US) {
+            usleep(slack_us - ARRIVAL_SPIN_US);
+        }
+        now = ticks::get_ticks();
+    }
+}
 
-    //TODO SET A BARRIER
-    usleep(3 * 1000000); //Allow for thread migration before resetting the clocks
+/*
+ * Returns the intended send time (in ticks) of the next transaction, sleeping until then if we are ahead of schedule.
+ * If we are behind schedule the transaction is issued right away, and the delay is charged to its latency
+ */
+template<typename IO, typename KeyEncoder>
+u64 FKVB<IO, KeyEncoder>::wait_next_arrival(fkvb_thread_state *state) {
+    const u64 intended = state->arrival->next();
+    u64 now = ticks::get_ticks();
+    while (now < intended) {
+        const u64 slack_us = (intended - now) / state->op_timer->tics_per_usec;
+        if (slack_us > ARRIVAL_SPIN_US) {
+            usleep(slack_us - ARRIVAL_SPIN_US);
+        }
+        now = ticks::get_ticks();
+    }
+    return intended;
+}
 
+template<typename IO, typename KeyEncoder>
+void *FKVB<IO, KeyEncoder>::tx_loop(void *_state) {
 
     fkvb_thread_state *state = static_cast<fkvb_thread_state *> (_state);
     state->kv->thread_local_entry();
-    state->xput_stats->reset_xput_stats();
     tid = state->id;
+    wait_start(state);
+    state->xput_stats->reset_xput_stats(start_ticks, start_wall_usec);
     u64 remaining = state->duration;
+    u64 intended = 0;
+    if (state->arrival) {
+        state->arrival->start(start_ticks);
+    }
+    if (state->async) {
+        async_loop(state);
+        reinsert_deleted(state, true);
+        state->xput_stats->finish();
+        state->kv->thread_local_exit();
+        pthread_exit(NULL);
+    }
     switch (state->duration_t) {
 
 
@@ -710,10 +1081,20 @@ void *FKVB<IO>::tx_loop(void *_state) {
                 THREAD_PRINT("Each thread is going to do %lu ops", remaining);
             }
             while (state->running && remaining-- && !failed) {
+                if (state->arrival) {
+                    intended = wait_next_arrival(state);
+                }
                 do_transaction(state);
+                //Open loop: latency is measured from the intended send time, not from the actual one
+                state->correct_latency(intended, 0);
                 state->add_sample(state->last_duration, state->last_init, state->last_op);
                 state->add_sample(zrl_fkvb_begin_latency, OP_INIT);
                 state->add_sample(zrl_fkvb_commit_latency, OP_COMMIT);
+                state->add_sample(zrl_fkvb_tx_alloc_latency, OP_TX_ALLOC);
+                state->xput_stats->add_grv_sample(zrl_fkvb_grv_requests, zrl_fkvb_grv_stale);
+                zrl_fkvb_grv_requests = zrl_fkvb_grv_stale = 0;
+                state->add_retry_sample(zrl_fkvb_retries);
+                reinsert_deleted(state, false);
                 if (!(remaining % 5000) && !state->id) {
                     THREAD_PRINT("Remaining %lu", remaining);
                 }
@@ -731,22 +1112,33 @@ void *FKVB<IO>::tx_loop(void *_state) {
             u64 now, end = init_time + state->duration * 1000000, last_print = init_time;
             u64 last_start=0;
             u64 last_taken=0;
+            const u64 expected_interval = (u64) sleep_time_us * state->op_timer->tics_per_usec;
             while (state->running && ((now = state->op_timer->t_long_usec()) < end) && !failed) {
-                if(((last_taken=now-last_start)<sleep_time_us)){
+                if (state->arrival) {
+                    intended = wait_next_arrival(state);
+                } else if(((last_taken=now-last_start)<sleep_time_us)){
                         usleep(sleep_time_us);// - last_taken);
                 }    
                 last_start=now;
                 do_transaction(state);
+                //Open loop: latency is measured from the intended send time, not from the actual one.
+                //Think time: the ops we did not issue while this one was stalled are back-filled
+                state->correct_latency(intended, state->arrival ? 0 : expected_interval);
                 state->add_sample(state->last_duration, state->last_init, state->last_op);
                 state->add_sample(zrl_fkvb_begin_latency, OP_INIT);
                 state->add_sample(zrl_fkvb_commit_latency, OP_COMMIT);
+                state->add_sample(zrl_fkvb_tx_alloc_latency, OP_TX_ALLOC);
+                state->xput_stats->add_grv_sample(zrl_fkvb_grv_requests, zrl_fkvb_grv_stale);
+                zrl_fkvb_grv_requests = zrl_fkvb_grv_stale = 0;
+                state->add_retry_sample(zrl_fkvb_retries);
                 if (state->last_op == OP_GENERIC) {
-                    state->add_breakdown_sample(OP_GENERIC, state->last_duration,
+                    state->add_breakdown_sample(state->last_duration,
                                                 state->last_duration -
                                                 (zrl_fkvb_begin_latency + zrl_fkvb_commit_latency),
                                                 zrl_fkvb_begin_latency,
                                                 zrl_fkvb_commit_latency);
                 }
+                reinsert_deleted(state, false);
                 if (((now - last) > 1000000) && !state->id) {
                     THREAD_PRINT("%lu Remaining %lu sec", now - init_time, (end - now) / 1000000);
                     last = now;
@@ -762,19 +1154,240 @@ void *FKVB<IO>::tx_loop(void *_state) {
             assert(false);
         }
     }
+    //Keys still waiting to be inserted back would be missing from the next tests on the same data
+    reinsert_deleted(state, true);
+    state->xput_stats->finish();
     state->kv->thread_local_exit();
     pthread_exit(NULL);
 }
 
-template<typename IO>
-void *FKVB<IO>::populate_loop(void *_state) {
+/*
+ * Invoked by the backend when an asynchronous transaction completes (for FDB, on the network thread).
+ * We only timestamp the transaction and hand it back to its worker, which records the statistics
+ */
+template<typename IO, typename KeyEncoder>
+void FKVB<IO, KeyEncoder>::on_async_complete(void *ctx, int rc, uint64_t begin_latency, uint64_t commit_latency,
+                                             const kv_retry_stats &retries) {
+    struct async_slot *slot = static_cast<struct async_slot *>(ctx);
+    slot->end = ticks::get_ticks();
+    slot->rc = rc;
+    slot->begin_latency = begin_latency;
+    slot->commit_latency = commit_latency;
+    slot->retries = retries;
+    struct async_engine *engine = slot->engine;
+    {
+        std::lock_guard<std::mutex> l(engine->lock);
+        engine->completed.push_back(slot);
+    }
+    engine->cv.notify_one();
+}
+
+/*
+ * Counterpart of tx_loop with more than one generic transaction in flight. The worker starts transactions as long as
+ * it has free slots (and, in open loop, as long as they are due), and then waits for completions.
+ * Each completed transaction is recorded exactly as in tx_loop, with its own latency sample
+ */
+template<typename IO, typename KeyEncoder>
+void FKVB<IO, KeyEncoder>::async_loop(fkvb_thread_state *state) {
+    struct async_engine *engine = state->async;
+    std::vector<struct async_slot *> harvested;
+    harvested.reserve(engine->slots.size());
+    const bool by_ops = state->duration_t == duration_type::OPS_N;
+    const u64 tics_per_sec = state->op_timer->tics_per_sec;
+    const u64 init = ticks::get_ticks(), end = init + state->duration * tics_per_sec;
+    u64 to_issue = state->duration, last_print = init;
+    if (0 == state->id) {
+        THREAD_PRINT("Each thread is going to %s %lu %s with %zu transactions in flight", by_ops ? "do" : "run for",
+                     state->duration, by_ops ? "ops" : "seconds", engine->slots.size());
+    }
+
+    while (1) {
+        u64 now = ticks::get_ticks();
+        const bool issuing = state->running && !failed && (by_ops ? to_issue > 0 : now < end);
+        if (!issuing && engine->idle()) {
+            break;
+        }
+        while (issuing && !engine->free_slots.empty() && (!by_ops || to_issue)) {
+            u64 intended = 0;
+            if (state->arrival) {
+                if (state->arrival->peek() > ticks::get_ticks()) {
+                    break;
+                }
+                intended = state->arrival->next();
+            }
+            struct async_slot *slot = engine->free_slots.back();
+            engine->free_slots.pop_back();
+            build_generic(state, slot->keys, slot->key_sizes, slot->rw, slot->flags, slot->put_ptr, slot->value_sizes);
+            slot->intended = intended;
+            slot->start = ticks::get_ticks();
+            state->kv->generic_async(state->generic_ops, slot->rw, slot->flags, slot->keys, slot->key_sizes,
+                                     slot->put_ptr, slot->value_sizes, on_async_complete, slot);
+            slot->alloc_latency = zrl_fkvb_tx_alloc_latency;
+            to_issue--;
+        }
+
+        {
+            std::unique_lock<std::mutex> l(engine->lock);
+            if (engine->completed.empty()) {
+                now = ticks::get_ticks();
+                if (issuing && state->arrival && !engine->free_slots.empty()) {
+                    //Sleep until the next arrival, unless a transaction completes first
+                    const u64 next = state->arrival->peek();
+                    if (next > now) {
+                        engine->cv.wait_for(l, std::chrono::microseconds(
+                                (next - now) / state->op_timer->tics_per_usec));
+                    }
+                } else if (!engine->idle()) {
+                    engine->cv.wait(l, [engine] { return !engine->completed.empty(); });
+                }
+            }
+            harvested.swap(engine->completed);
+        }
+
+        for (struct async_slot *slot : harvested) {
+            state->last_op = OP_GENERIC;
+            state->last_init = slot->start;
+            state->last_duration = slot->end - slot->start;
+            zrl_fkvb_begin_latency = slot->begin_latency;
+            zrl_fkvb_commit_latency = slot->commit_latency;
+            state->correct_latency(slot->intended, 0);
+            state->add_sample(state->last_duration, state->last_init, state->last_op);
+            state->add_sample(zrl_fkvb_begin_latency, OP_INIT);
+            state->add_sample(zrl_fkvb_commit_latency, OP_COMMIT);
+            state->add_sample(slot->alloc_latency, OP_TX_ALLOC);
+            state->xput_stats->add_grv_sample(zrl_fkvb_grv_requests, zrl_fkvb_grv_stale);
+            zrl_fkvb_grv_requests = zrl_fkvb_grv_stale = 0;
+            state->add_retry_sample(slot->retries);
+            state->add_breakdown_sample(state->last_duration,
+                                        state->last_duration - (zrl_fkvb_begin_latency + zrl_fkvb_commit_latency),
+                                        zrl_fkvb_begin_latency,
+                                        zrl_fkvb_commit_latency);
+            if (slot->rc) {
+                ERROR("DO_GENERIC FAILED");
+                failed = true;
+            }
+            engine->free_slots.push_back(slot);
+        }
+        harvested.clear();
+
+        if (!state->id && !by_ops && (now - last_print) > tics_per_sec) {
+            THREAD_PRINT("Remaining %lu sec", now < end ? (end - now) / tics_per_sec : 0);
+            last_print = now;
+        }
+    }
+}
+
+//Same as on_async_complete, for bulk inserts
+template<typename IO, typename KeyEncoder>
+void FKVB<IO, KeyEncoder>::on_bulk_complete(void *ctx, int rc, uint64_t begin_latency, uint64_t commit_latency,
+                                            const kv_retry_stats &retries) {
+    UNUSED(begin_latency);
+    UNUSED(commit_latency);
+    struct bulk_batch *b = static_cast<struct bulk_batch *>(ctx);
+    b->end = ticks::get_ticks();
+    b->rc = rc;
+    b->retries = retries;
+    struct bulk_engine *engine = b->engine;
+    {
+        std::lock_guard<std::mutex> l(engine->lock);
+        engine->completed.push_back(b);
+    }
+    engine->cv.notify_one();
+}
+
+//Prints the advancement of the population every time rollout more keys have been inserted (thread 0 only)
+template<typename IO, typename KeyEncoder>
+void FKVB<IO, KeyEncoder>::report_population(fkvb_thread_state *state, u32 remaining, u32 &done, u32 &print_stats,
+                                             u32 rollout) {
+    if (state->id) {
+        return;
+    }
+    while (done >= rollout) {
+        THREAD_PRINT("Population: remaining (per thread) %u", remaining);
+        done -= rollout;
+        print_stats++;
+        if (print_stats == 10) {
+            THREAD_PRINT("Population: info");
+            state->kv->print_stats();
+            print_stats = 0;
+        }
+    }
+}
+
+/*
+ * Population with bulk inserts of --bulk_keys keys (or --bulk_bytes bytes). With --bulk_in_flight 1 they are run
+ * synchronously; otherwise up to --bulk_in_flight of them are committing at the same time, as in async_loop, so that
+ * building the next batch and waiting for the cluster overlap
+ */
+template<typename IO, typename KeyEncoder>
+void FKVB<IO, KeyEncoder>::populate_bulk_loop(fkvb_thread_state *state, u32 ops, u32 rollout) {
+    struct bulk_engine *engine = state->bulk;
+    std::vector<struct bulk_batch *> harvested;
+    harvested.reserve(engine->batches.size());
+    const bool sync = engine->batches.size() == 1;
+    u32 remaining = ops, done = 0, print_stats = 0;
+    int rc;
+
+    while (1) {
+        const bool issuing = ops && state->running && !failed;
+        if (!issuing && engine->idle()) {
+            break;
+        }
+        while (issuing && ops && !engine->free_batches.empty()) {
+            struct bulk_batch *b = engine->free_batches.back();
+            engine->free_batches.pop_back();
+            build_bulk(state, b, ops > engine->max_keys ? engine->max_keys : ops, engine->max_bytes);
+            ops -= b->num_keys;
+            if (sync) {
+                rc = do_populate_bulk(state, b);
+                if (rc) {
+                    FATAL("POPULATION BULK WRITE FAILED");
+                }
+                record_bulk(state, b, zrl_fkvb_retries);
+                engine->free_batches.push_back(b);
+                remaining -= b->num_keys;
+                done += b->num_keys;
+                report_population(state, remaining, done, print_stats, rollout);
+                break;
+            }
+            b->start = ticks::get_ticks();
+            state->kv->put_bulk_async((size_t) b->num_keys, b->keys, b->key_sizes, b->values, b->value_sizes,
+                                      on_bulk_complete, b);
+        }
+        if (sync) {
+            continue;
+        }
+
+        {
+            std::unique_lock<std::mutex> l(engine->lock);
+            engine->cv.wait(l, [engine] { return !engine->completed.empty(); });
+            harvested.swap(engine->completed);
+        }
+
+        for (struct bulk_batch *b : harvested) {
+            if (b->rc) {
+                FATAL("POPULATION BULK WRITE FAILED");
+            }
+            state->last_init = b->start;
+            state->last_duration = b->end - b->start;
+            record_bulk(state, b, b->retries);
+            engine->free_batches.push_back(b);
+            remaining -= b->num_keys;
+            done += b->num_keys;
+        }
+        harvested.clear();
+        report_population(state, remaining, done, print_stats, rollout);
+    }
+}
+
+template<typename IO, typename KeyEncoder>
+void *FKVB<IO, KeyEncoder>::populate_loop(void *_state) {
     fkvb_thread_state *state = (fkvb_thread_state *) _state;
     state->kv->thread_local_entry();
     state->xput_stats->reset_xput_stats();
     u32 ops = state->key_index_generator->_end - state->key_index_generator->_beg;
-    unsigned int i, rc, rollout, stats, done = 0, print_stats = 0;
+    unsigned int rc, rollout, stats, done = 0, print_stats = 0;
     state->last_op = OP_INSERT;
-    UNUSED(i);
     //We want to print advancement every time we insert 1% of the total keys
     rollout = (int) (((double) ops) * 0.01);
     rollout += 500;
@@ -793,47 +1406,20 @@ void *FKVB<IO>::populate_loop(void *_state) {
     UNUSED(stats);
     if (!state->id)THREAD_PRINT("Population: ops per thread  %u. Rollout every %d", ops, rollout);
 
+    if (state->bulk) {
+        populate_bulk_loop(state, ops, rollout);
+        ops = 0;
+    }
     while (ops && state->running && !failed) {
-
-#if BULK_SIZE > 1
-        u32 dd = ops > BULK_SIZE ? BULK_SIZE : ops;
-        rc = do_populate_bulk(state, dd);
-        if (rc) {
-            FATAL("POPULATION BULK WRITE FAILED");
-        }
-//We need that #samples is the number of keys so that we can double check the load phase
-//So we add a sample for each key written. The time of an op in a bulk insert is the time of the bulk insert
-//Divided by the number of keys written
-        for (i = 0; i < dd; i++) {
-            //NOTE: this is done within a loop. This means that one op can belong
-            //To one epoch, and one to another epoch (if the bulk happens across two epochs)
-            //This is why sometimes we get odd values as xput in loading ;)
-            state->add_sample(state->last_duration / dd, state->last_init, state->last_op);
-        }
-
-        ops -= dd;
-        done += dd;
-#else
         rc = do_populate(state);
         if(rc){
             FATAL("POPULATION WRITE FAILED");
         }
         state->add_sample(state->last_duration, state->last_init, state->last_op);
+        state->add_retry_sample(zrl_fkvb_retries);
         ops--;
-#endif
-        if (!state->id) {
-            while (done >= rollout) {
-                THREAD_PRINT("Population: remaining (per thread) %u", ops);
-                done -= rollout;
-                print_stats++;
-                if (print_stats == 10) {
-                    THREAD_PRINT("Population: info");
-                    state->kv->print_stats();
-                    print_stats = 0;
-                }
-
-            }
-        }
+        done++;
+        report_population(state, ops, done, print_stats, rollout);
         /*
         if ((!(ops % rollout)) && (!state->id)) {//FIXME: this is only printed if rollout is a multiple of bulk_size...
             THREAD_PRINT("Population: remaining (per thread) %u", ops);
@@ -843,16 +1429,60 @@ void *FKVB<IO>::populate_loop(void *_state) {
             state->kv->print_stats();
         }*/
     }
+    state->xput_stats->finish();
     state->kv->thread_local_exit();
     pthread_exit(NULL);
 }
 
-template<typename IO>
-bool FKVB<IO>::do_transaction(fkvb_thread_state *state) {
+/*
+ * Periodically writes out the epochs completed by the threads of a flusher, and frees their slots.
+ * The per-process aggregate of a second is written once all the threads that are still running have completed it.
+ * After done is set (all threads have been joined), writes out what is left and exits
+ */
+template<typename IO, typename KeyEncoder>
+void *FKVB<IO, KeyEncoder>::flush_loop(void *_flusher) {
+    xput_flusher *flusher = static_cast<xput_flusher *> (_flusher);
+    bool last;
+    do {
+        last = flusher->done.load();
+        u64 until = ~0ULL; //Seconds before this one have been completed by all running threads
+        for (u32 i = 0; i < flusher->num_states; i++) {
+            fkvb_thread_state *state = flusher->states[i];
+            xput_statistics *stats = state->xput_stats;
+            const bool finished = stats->finished.load(std::memory_order_acquire);
+            const u32 completed = stats->completed.load(std::memory_order_acquire);
+            const std::string id = std::to_string(state->id);
+            for (u32 e = stats->flushed.load(std::memory_order_relaxed); e < completed; e++) {
+                stats->epoch(e).write(id, flusher->xput, flusher->hist, flusher->retry);
+                flusher->aggregate(stats->epoch(e));
+                stats->flushed.store(e + 1, std::memory_order_release);
+            }
+            if (!finished) {
+                const u64 thread_until = completed ? stats->first_sec + completed : 0;
+                until = thread_until < until ? thread_until : until;
+            }
+        }
+        flusher->write_aggregates(last ? ~0ULL : until);
+        if (last) {
+            flusher->write_corrections();
+        }
+        flusher->xput.flush();
+        flusher->hist.flush();
+        flusher->retry.flush();
+        if (!last) {
+            usleep(XPUT_FLUSH_US);
+        }
+    } while (!last);
+    return nullptr;
+}
+
+template<typename IO, typename KeyEncoder>
+bool FKVB<IO, KeyEncoder>::do_transaction(fkvb_thread_state *state) {
+    int rc;
+    state->ops_done++;
     OPS next_op = state->next_op_generator->next();
     state->last_op = next_op;
     THREAD_TRACE("Next op is %s", op_to_string(next_op));
-    int rc;
     switch (next_op) {
         case OP_READ:
             rc = do_read(state);
@@ -923,8 +1553,30 @@ bool FKVB<IO>::do_transaction(fkvb_thread_state *state) {
                 failed = true;
             }
             break;
+        case OP_DELETE:
+            rc = do_delete(state);
+            if (rc) {
+                ERROR("DO_DELETE FAILED with code %d", rc);
+                failed = true;
+            }
+            break;
+        case OP_CLEAR_RANGE:
+            rc = do_clear_range(state);
+            if (rc) {
+                ERROR("DO_CLEAR_RANGE FAILED with code %d", rc);
+                failed = true;
+            }
+            break;
+        case OP_ATOMIC:
+            rc = do_atomic(state);
+            if (rc) {
+                ERROR("DO_ATOMIC FAILED with code %d", rc);
+                failed = true;
+            }
+            break;
         case OP_INIT:
         case OP_COMMIT:
+        case OP_TX_ALLOC:
             FATAL("Unexpected next operation %d", next_op);
         default:
             FATAL("Operation not recognized %d", next_op);
@@ -933,8 +1585,8 @@ bool FKVB<IO>::do_transaction(fkvb_thread_state *state) {
     return true;
 }
 
-template<typename IO>
-void FKVB<IO>::sigusr1_handler(int s) {
+template<typename IO, typename KeyEncoder>
+void FKVB<IO, KeyEncoder>::sigusr1_handler(int s) {
     unsigned i;
     for (i = 0; i < conf->thread_nr_m; i++) {
         population_states[i]->running = false;
@@ -944,15 +1596,15 @@ void FKVB<IO>::sigusr1_handler(int s) {
     }
 }
 
-template<typename IO>
-void FKVB<IO>::sigusr2_handler(int s) {
+template<typename IO, typename KeyEncoder>
+void FKVB<IO, KeyEncoder>::sigusr2_handler(int s) {
     PRINT("RECEIVED SIGUSR2");
     population_barrier = false;
 }
 
 
-template<typename IO>
-void FKVB<IO>::sigint_handler(int s) {
+template<typename IO, typename KeyEncoder>
+void FKVB<IO, KeyEncoder>::sigint_handler(int s) {
     PRINT("RECEIVED SIGINT");
     //Shortcut
     failed = true;
@@ -969,8 +1621,38 @@ void signal_barrier(const char *file) {
     myfile.close();
 }
 
-template<typename IO>
-void FKVB<IO>::run() {
+/*
+ * Counts the keys in the store, in conf->count_ranges sub-ranges counted concurrently. The boundaries of the
+ * sub-ranges are quantiles of a sample of the keys built by the given threads, so that the sub-ranges have about the
+ * same number of keys whatever the key type (random and sharded keys are not sorted by index)
+ */
+#define COUNT_SAMPLES_PER_RANGE 16
+template<typename IO, typename KeyEncoder>
+u64 FKVB<IO, KeyEncoder>::count_keys(fkvb_thread_state **sts, u32 num_states) {
+    struct timer _timer = timer(conf->frequency);
+    _timer.start_t();
+    const u64 samples = std::min((u64) conf->num_keys, (u64) conf->count_ranges * COUNT_SAMPLES_PER_RANGE);
+    std::vector<std::string> keys, boundaries;
+    char key[KEY_BUFFER_SIZE];
+    size_t key_size;
+    u64 s;
+    for (s = 0; s < samples; s++) {
+        sts[s % num_states]->key_builder->build((int) (s * conf->num_keys / samples), key, &key_size);
+        keys.push_back(std::string(key, key_size));
+    }
+    std::sort(keys.begin(), keys.end());
+    for (s = 1; s < conf->count_ranges && samples; s++) {
+        boundaries.push_back(keys[s * samples / conf->count_ranges]);
+    }
+    const u64 num_keys = kv->count_keys(boundaries);
+    const u64 count_ms = _timer.stop_t_milli();
+    PRINT_FORMAT("KEY COUNT: %lu keys in %lu ms with %zu ranges: %.0f keys/s", num_keys, count_ms,
+                 boundaries.size() + 1, (double) num_keys * 1000.0 / (double) (count_ms ? count_ms : 1));
+    return num_keys;
+}
+
+template<typename IO, typename KeyEncoder>
+void FKVB<IO, KeyEncoder>::run() {
 
     unsigned i;
 #if 0
@@ -1003,6 +1685,34 @@ void FKVB<IO>::run() {
     }
     myfile2.close();
 
+    //Latency histograms, which can be merged exactly across threads and processes
+    const char *hist_ext[] = {".loadhist", ".runhist"};
+    for (const char *ext: hist_ext) {
+        std::stringstream ss3;
+        ss3 << conf->xput_file.c_str() << ext;
+        std::ofstream myfile3(ss3.str().c_str(), std::fstream::out | std::fstream::trunc);
+        if (myfile3.fail()) {
+            ERROR("Error opening %s", ss3.str().c_str());
+            throw std::ios_base::failure(std::strerror(errno));
+        }
+        myfile3 << "#sub_bucket_bits " << HIST_SUB_BUCKET_BITS << " max_bits " << HIST_MAX_BITS
+                << " tics_per_sec " << conf->frequency << "\n";
+        myfile3.close();
+    }
+    //Attempts, conflicts and errors of each op type
+    const char *retry_ext[] = {".loadretry", ".runretry"};
+    for (const char *ext: retry_ext) {
+        std::stringstream ss4;
+        ss4 << conf->xput_file.c_str() << ext;
+        std::ofstream myfile4(ss4.str().c_str(), std::fstream::out | std::fstream::trunc);
+        if (myfile4.fail()) {
+            ERROR("Error opening %s", ss4.str().c_str());
+            throw std::ios_base::failure(std::strerror(errno));
+        }
+        myfile4 << "#thread_id wall_sec op attempts conflicts backoff_ticks error_code:count ...\n";
+        myfile4.close();
+    }
+
 
     kv->thread_local_entry(); //We need this to use thread_local variables 
 
@@ -1021,10 +1731,19 @@ void FKVB<IO>::run() {
     struct timer _timer = timer(conf->frequency);
     // Initialize and set thread joinable
     if (conf->num_population_threads) {
-        PRINT_FORMAT("Starting population with BULK_SIZE %u", BULK_SIZE);
+        PRINT_FORMAT("Starting population with up to %u %s per transaction and %u transactions in flight per thread",
+                     conf->bulk_bytes ? conf->bulk_bytes : conf->bulk_keys, conf->bulk_bytes ? "bytes" : "keys",
+                     conf->bulk_keys > 1 || conf->bulk_bytes ? conf->bulk_in_flight : 1);
 
 
         _timer.start_t();
+        PRINT_FORMAT("Writing xput to %s", ss1.str().c_str());
+        xput_flusher load_flusher(population_states, conf->num_population_threads, ss1.str(),
+                                  conf->xput_file + ".loadhist", conf->xput_file + ".loadretry");
+        rc = pthread_create(&load_flusher.thread, &attr, flush_loop, &load_flusher);
+        if (rc) {
+            FATAL("Error: unable to create flusher thread %d\n", rc);
+        }
         //Populate
         for (i = 0; i < conf->num_population_threads; i++) {
             rc = pthread_create(&population_thread_arr[i], &attr, populate_loop, population_states[i]);
@@ -1056,28 +1775,47 @@ void FKVB<IO>::run() {
             if (rc) {
                 FATAL("Error: unable to join %d\n", rc);
             }
-            fkvb_thread_state *state = population_states[i];
-            std::stringstream ss;
-            ss << conf->xput_file.c_str() << ".loadxput";
-            if (!i)PRINT_FORMAT("Dumping  xput to %s", ss.str().c_str());
-            state->dump_xputs(ss.str().c_str());
         }
-#if 0
-        PRINT_FORMAT(">> Checking number of keys at the end of the population <<");
-        if (!conf->instance_id) {
-            u64 written;
-            while ( (! failed) && (written = kv->get_size()) < conf->num_keys) {
+        {
+            const u64 load_ms = _timer.stop_t_milli();
+            u64 loaded_keys = 0, loaded_bytes = 0;
+            for (i = 0; i < conf->num_population_threads; i++) {
+                loaded_keys += population_states[i]->loaded_keys;
+                loaded_bytes += population_states[i]->loaded_bytes;
+            }
+            const double load_sec = load_ms ? (double) load_ms / 1000.0 : 1e-3;
+            PRINT_FORMAT("LOAD: %lu keys, %.2f MB in %lu ms: %.0f keys/s, %.2f MB/s", loaded_keys,
+                         (double) loaded_bytes / 1e6, load_ms, (double) loaded_keys / load_sec,
+                         (double) loaded_bytes / 1e6 / load_sec);
+        }
+        load_flusher.done.store(true);
+        rc = pthread_join(load_flusher.thread, &status);
+        if (rc) {
+            FATAL("Error: unable to join the flusher %d\n", rc);
+        }
+        if (conf->count_ranges && !conf->instance_id) {
+            PRINT_FORMAT(">> Checking number of keys at the end of the population <<");
+            u64 written = 0;
+            u32 waited = 0;
+            //The other instances may still be loading their keys
+            while ((!failed) && (written = count_keys(population_states, conf->num_population_threads)) <
+                                conf->num_keys) {
+                if (waited >= conf->count_wait_sec) {
+                    ERROR("%lu keys missing after waiting %u sec: written keys %lu vs %u", conf->num_keys - written,
+                          waited, written, conf->num_keys);
+                    break;
+                }
                 PRINT_FORMAT("Written keys %lu vs %u", written, conf->num_keys);
                 usleep(1000000);
+                waited++;
             }
 
             PRINT_FORMAT("POPULATION ENDED. Written %lu keys in %lu ms", written, _timer.stop_t_milli());
+        } else {
+            PRINT_FORMAT(">> SKIPPING KEY_CHECK <<");
+            PRINT_FORMAT("POPULATION ENDED in %lu ms", _timer.stop_t_milli());
         }
-#else
-        PRINT_FORMAT(">> SKIPPING KEY_CHECK <<");
-        PRINT_FORMAT("POPULATION ENDED in %lu ms", _timer.stop_t_milli());
         kv->print_stats();
-#endif
 
 
         if (!population_barrier) {
@@ -1100,6 +1838,16 @@ void FKVB<IO>::run() {
         PRINT_FORMAT("Running with %d threads", NUM_THREADS);
 
         _timer.start_t();
+        xput_flusher run_flusher(states, NUM_THREADS, ss2.str(), conf->xput_file + ".runhist",
+                                 conf->xput_file + ".runretry");
+        rc = pthread_create(&run_flusher.thread, &attr, flush_loop, &run_flusher);
+        if (rc) {
+            FATAL("Error: unable to create flusher thread %d\n", rc);
+        }
+        rc = pthread_barrier_init(&start_barrier, NULL, NUM_THREADS);
+        if (rc) {
+            FATAL("Error: unable to init the start barrier %d\n", rc);
+        }
         for (i = 0; i < NUM_THREADS; i++) {
             rc = pthread_create(&threads[i], &attr, tx_loop, states[i]);
             if (rc) {
@@ -1133,21 +1881,20 @@ void FKVB<IO>::run() {
                 FATAL("Error: unable to join %d\n", rc);
             }
             //fprintf(stdout, "Completing thread %d with rc %d\n", i, rc);
-            fkvb_thread_state *state = states[i];
-            std::stringstream ss;
-            ss << conf->xput_file.c_str() << ".runxput";
-            state->dump_xputs(ss.str().c_str());
-
         }
+        run_flusher.done.store(true);
+        rc = pthread_join(run_flusher.thread, &status);
+        if (rc) {
+            FATAL("Error: unable to join the flusher %d\n", rc);
+        }
+        pthread_barrier_destroy(&start_barrier);
         PRINT_FORMAT("Time taken %lu ms", _timer.stop_t_milli());
-#if 0
-        PRINT_FORMAT("Checking number of items at the end of the test");
-        if (1 && !conf->instance_id) {
-            PRINT_FORMAT("Num keys at the end of the test %lu\n", kv->get_size());
+        if (conf->count_ranges && !conf->instance_id) {
+            PRINT_FORMAT("Checking number of items at the end of the test");
+            PRINT_FORMAT("Num keys at the end of the test %lu\n", count_keys(states, NUM_THREADS));
+        } else {
+            PRINT_FORMAT("*NOT* Checking number of items at the end of the test");
         }
-#else
-        PRINT_FORMAT("*NOT* Checking number of items at the end of the test");
-#endif
         PRINT_FORMAT("Shutting down the KV");
     } else {
         PRINT("Only population: skipping client test");
@@ -1159,6 +1906,41 @@ void FKVB<IO>::run() {
 
 }
 
+template<typename KeyEncoder>
+static void bench_key_encoder(const char *key_type, KeyEncoder *encoder, u64 num_builds, u32 num_keys) {
+    char key[KEY_BUFFER_SIZE];
+    size_t key_size = 0;
+    u64 i, checksum = 0; //So that the builds are not optimized away
+    u32 index = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (i = 0; i < num_builds; i++) {
+        encoder->build((int) index, key, &key_size);
+        checksum += (u8) key[key_size - 1];
+        if (++index == num_keys) {
+            index = 0;
+        }
+    }
+    const double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    PRINT_FORMAT("KEY BENCH: %s %lu keys of %zu to %zu bytes in %.3f sec: %.0f keys/s (checksum %lu)", key_type,
+                 num_builds, encoder->lengths.min_size, encoder->lengths.max_size, sec,
+                 sec > 0 ? (double) num_builds / sec : 0., checksum);
+    delete encoder;
+}
+
+//Builds conf->bench_keys keys of every key type, of the key sizes and out of the number of keys of the test
+void bench_key_encoders(fkvb_test_conf *conf) {
+    const std::string shard("\x12\x34\x56\x78\x9a\xbc\xde\x01", 8); //The cost does not depend on the shard
+    const key_lengths &lengths = get_key_lengths(conf);
+    bench_key_encoder("fkvb", decimal_key_encoder::create(lengths, conf->num_keys, nullptr), conf->bench_keys,
+                      conf->num_keys);
+    bench_key_encoder("sharded_fkvb", decimal_key_encoder::create(lengths, conf->num_keys, &shard), conf->bench_keys,
+                      conf->num_keys);
+    bench_key_encoder("random", random_key_encoder::create(lengths, conf->num_keys, nullptr), conf->bench_keys,
+                      conf->num_keys);
+    bench_key_encoder("sharded_random", random_key_encoder::create(lengths, conf->num_keys, &shard),
+                      conf->bench_keys, conf->num_keys);
+}
+
 seed_t get_random_seed() {
 
 #if defined(_LINUX)
@@ -1245,6 +2027,10 @@ const char *op_to_string(OPS op) {
         VAL(OP_GENERIC);
         VAL(OP_INIT);
         VAL(OP_COMMIT);
+        VAL(OP_TX_ALLOC);
+        VAL(OP_ATOMIC);
+        VAL(OP_DELETE);
+        VAL(OP_CLEAR_RANGE);
     case OP_LAST:
     default:
         assert(0);
@@ -1255,7 +2041,10 @@ const char *op_to_string(OPS op) {
 
 
 template
-class FKVB<int>;
+class FKVB<int, decimal_key_encoder>;
+
+template
+class FKVB<int, random_key_encoder>;
 
 
 //TODO: Decouple fkvb interface and internals
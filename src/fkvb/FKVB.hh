@@ -25,18 +25,23 @@
 #include "defs.hh"
 #include <algorithm>
 #include "StringBuilder.hh"
+#include "KeyEncoder.hh"
 #include <chrono>
 #include <cstring>
 #include "profiling.hh"
 #include "FKVB_g.hh"
 #include "reservoir.hh"
+#include "histogram.hh"
 #include <ticks.hh>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <map>
-
-#define BULK_SIZE 20
+#include <deque>
+#include <array>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 
 //#define TRACE_PERF  //Enable/disable reservoir sampling-based statistics
 #define XPUT_SAMPLES 172800  //48 hrs at one second interval
@@ -56,7 +61,16 @@
 
 #define USE_RESERVOIR 1
 
-template<typename IO>
+const char *op_to_string(OPS op);
+
+//Microbenchmark of the key encoders (--bench_keys): prints the keys/s of every key type, without a KV
+void bench_key_encoders(fkvb_test_conf *conf);
+
+/*
+ * KeyEncoder builds the keys of the ops (see KeyEncoder.hh). It is a template parameter so that the per-op key
+ * building is resolved at compile time
+ */
+template<typename IO, typename KeyEncoder>
 class FKVB : public FKVB_g {
 private:
 
@@ -100,6 +114,36 @@ private:
 
     };
 
+    /*
+     * Open-loop schedule of a thread. Arrivals are computed in ticks, independently of the completion
+     * of previous transactions, so that a slow transaction does not delay the ones that should follow
+     */
+#define ARRIVAL_SPIN_US 50 //Below this slack we spin instead of sleeping
+    struct arrival_pattern {
+        rand48 rng;
+        const double mean_gap; //ticks
+        const bool poisson;
+        double next_arrival;
+
+        arrival_pattern(double rate, u64 tics_per_sec, bool _poisson, long seed) :
+                rng(seed), mean_gap((double) tics_per_sec / rate), poisson(_poisson), next_arrival(0) {}
+
+        void start(u64 now) {
+            next_arrival = (double) now;
+        }
+
+        u64 peek() const {
+            return (u64) next_arrival;
+        }
+
+        u64 next() {
+            const u64 ret = (u64) next_arrival;
+            //Inverse transform of the exponential distribution. 1 - u is in (0, 1]
+            next_arrival += poisson ? -log(1.0 - rng.drand()) * mean_gap : mean_gap;
+            return ret;
+        }
+    };
+
     enum duration_type {
         OPS_N = 1, SEC_N = 2
     };
@@ -109,6 +153,14 @@ private:
         u32 ops;
         u64 cumul; //mostly to double check with Little's formula that our measurements are ok
         u64 debt;
+        u64 wall_sec; //Wall-clock second (since the UNIX epoch) covered by the sample
+        u64 scan_rows; //Rows returned by the range reads of the epoch
+        u64 scan_bytes; //Bytes (keys + values) returned by the range reads of the epoch
+        u64 grv_requests; //Read versions requested to the cluster, i.e., not served by a GRV cache
+        u64 grv_stale; //Attempts that failed because their read version was too old or too new (1007, 1009)
+        u64 load_bytes; //Bytes (keys + values) written by the population
+        u64 deleted_keys; //Keys removed by deletes and clear ranges
+        u64 reinserted_keys; //Deleted keys inserted back
     };
 
     struct timer {
@@ -171,60 +223,284 @@ private:
 
     };
 
+    //Number of epochs a thread can record before the flusher has written them out. Completed epochs are written out
+    //by the flusher thread, so the memory used by the statistics of a thread does not grow with the length of the run
+#define XPUT_RING_SLOTS 8
+#define XPUT_FLUSH_US 100000
+
+    //Attempts of the ops of one type, as reported by the backend
+    struct retry_sample {
+        u64 attempts;
+        u64 conflicts;
+        u64 backoff; //Ticks
+        std::map<int, u64> errors; //Failed attempts by error code, conflicts excluded
+
+        void reset() {
+            attempts = conflicts = backoff = 0;
+            errors.clear();
+        }
+
+        void add(const kv_retry_stats &r) {
+            //Backends that do not retry do not count attempts
+            attempts += r.attempts ? r.attempts : 1;
+            conflicts += r.conflicts;
+            backoff += r.backoff_latency;
+            for (int e: r.errors) {
+                errors[e]++;
+            }
+        }
+
+        void merge(const struct retry_sample &r) {
+            attempts += r.attempts;
+            conflicts += r.conflicts;
+            backoff += r.backoff;
+            for (auto &p: r.errors) {
+                errors[p.first] += p.second;
+            }
+        }
+
+        u64 num_errors() const {
+            u64 n = 0;
+            for (auto &p: errors) {
+                n += p.second;
+            }
+            return n;
+        }
+    };
+
+    //Statistics of one epoch
+    struct xput_epoch {
+        struct xput_sample sample;
+        std::array<histogram, OP_LAST> latency;
+        t_reservoir<perc_s> breakdown; //Of generic ops
+        //Latency of all ops, as measured (service time) and corrected for coordinated omission
+        histogram service, corrected;
+        std::array<retry_sample, OP_LAST> retries;
+        u32 threads; //Threads whose statistics are in this epoch: more than one for per-process aggregates
+
+        void reset(u32 time, u64 wall_sec) {
+            threads = 1;
+            sample.ops = 0;
+            sample.time = time;
+            sample.cumul = 0;
+            sample.debt = 0;
+            sample.wall_sec = wall_sec;
+            sample.scan_rows = 0;
+            sample.scan_bytes = 0;
+            sample.grv_requests = 0;
+            sample.grv_stale = 0;
+            sample.load_bytes = 0;
+            sample.deleted_keys = 0;
+            sample.reinserted_keys = 0;
+            for (histogram &h: latency) {
+                h.reset();
+            }
+            breakdown.reset();
+            service.reset();
+            corrected.reset();
+            for (struct retry_sample &r: retries) {
+                r.reset();
+            }
+        }
+
+        //Adds the statistics of another thread for the same wall-clock second. The breakdown is not merged
+        void merge(const struct xput_epoch &e) {
+            sample.ops += e.sample.ops;
+            sample.cumul += e.sample.cumul;
+            sample.debt += e.sample.debt;
+            sample.scan_rows += e.sample.scan_rows;
+            sample.scan_bytes += e.sample.scan_bytes;
+            sample.grv_requests += e.sample.grv_requests;
+            sample.grv_stale += e.sample.grv_stale;
+            sample.load_bytes += e.sample.load_bytes;
+            sample.deleted_keys += e.sample.deleted_keys;
+            sample.reinserted_keys += e.sample.reinserted_keys;
+            for (u32 op = 0; op < OP_LAST; op++) {
+                latency[op].merge(e.latency[op]);
+                retries[op].merge(e.retries[op]);
+            }
+            service.merge(e.service);
+            corrected.merge(e.corrected);
+            threads += e.threads;
+        }
+
+        /*
+         * Writes the row of the epoch to the xput file, its histograms to the hist file and the attempts of each op
+         * type to the retry file
+         */
+        void write(const std::string &id, std::ostream &xput, std::ostream &hist, std::ostream &retry) {
+            struct retry_sample all;
+            all.reset();
+            for (struct retry_sample &r: retries) {
+                all.merge(r);
+            }
+            histogram &r_i = latency[OP_INSERT];
+            histogram &r_g = latency[OP_GENERIC];
+            histogram &r_u = latency[OP_UPDATE];
+            histogram &r_s = latency[OP_SCAN];
+
+            histogram &r_in = latency[OP_INIT];
+            histogram &r_co = latency[OP_COMMIT];
+            histogram &r_al = latency[OP_TX_ALLOC];
+            t_reservoir<perc_s> &bg = breakdown;
+            bg.sort();
+
+            perc_s p50 = bg.get_percentile(0.5);
+            perc_s p99 = bg.get_percentile(0.99);
+
+            histogram &r_se = service;
+            histogram &r_cr = corrected;
+
+            xput << id << " "
+                 << sample.time << " "
+                 << sample.ops << " "
+                 << sample.cumul << " "
+                 << sample.debt << " "
+                 << r_i.get_percentile(0.5) << " "
+                 << r_i.get_percentile(0.99) << " "
+                 << r_g.get_percentile(0.5) << " "
+                 << r_g.get_percentile(0.99) << " "
+                 << r_in.get_avg() << " "
+                 << r_in.get_percentile(0.5) << " "
+                 << r_in.get_percentile(0.99) << " "
+                 << r_co.get_avg() << " "
+                 << r_co.get_percentile(0.5) << " "
+                 << r_co.get_percentile(0.99) << " "
+                 << r_u.get_avg() << " "
+                 << r_u.get_percentile(0.5) << " "
+                 << r_u.get_percentile(0.99) << " "
+                 << p50.start << " "
+                 << p50.commit << " "
+                 << p50.total << " "
+                 << p99.start << " "
+                 << p99.commit << " "
+                 << p99.total << " "
+                 << r_se.get_percentile(0.5) << " "
+                 << r_se.get_percentile(0.99) << " "
+                 << r_se.get_percentile(0.999) << " "
+                 << r_cr.get_percentile(0.5) << " "
+                 << r_cr.get_percentile(0.99) << " "
+                 << r_cr.get_percentile(0.999) << " "
+                 << sample.wall_sec << " "
+                 << r_s.get_avg() << " "
+                 << r_s.get_percentile(0.5) << " "
+                 << r_s.get_percentile(0.99) << " "
+                 << sample.scan_rows << " "
+                 << sample.scan_bytes << " "
+                 << r_g.get_percentile(0.999) << " "
+                 << r_g.get_percentile(0.9999) << " "
+                 << threads << " "
+                 << r_al.get_avg() << " "
+                 << r_al.get_percentile(0.5) << " "
+                 << r_al.get_percentile(0.99) << " "
+                 << sample.grv_requests << " "
+                 << sample.grv_stale << " "
+                 << all.attempts << " "
+                 << all.conflicts << " "
+                 << all.num_errors() << " "
+                 << all.backoff << " "
+                 << sample.load_bytes << " "
+                 << sample.deleted_keys << " "
+                 << sample.reinserted_keys << "\n";
+
+            TRACE_FORMAT("%s %u %u %lu %lu", id.c_str(), sample.time, sample.ops, sample.cumul, sample.debt);
+
+            //One line per op with at least one sample: id wall_sec op histogram
+            //SERVICE and CORRECTED are the latencies of all ops, measured and corrected for coordinated omission
+            for (u32 op = OP_READ; op < OP_LAST; op++) {
+                if (latency[op].count) {
+                    hist << id << " " << sample.wall_sec << " " << op_to_string((OPS) op) << " ";
+                    latency[op].serialize(hist);
+                    hist << "\n";
+                }
+                if (retries[op].attempts) {
+                    const struct retry_sample &r = retries[op];
+                    retry << id << " " << sample.wall_sec << " " << op_to_string((OPS) op) << " " << r.attempts << " "
+                          << r.conflicts << " " << r.backoff;
+                    for (auto &p: r.errors) {
+                        retry << " " << p.first << ":" << p.second;
+                    }
+                    retry << "\n";
+                }
+            }
+            if (service.count) {
+                hist << id << " " << sample.wall_sec << " SERVICE ";
+                service.serialize(hist);
+                hist << "\n" << id << " " << sample.wall_sec << " CORRECTED ";
+                corrected.serialize(hist);
+                hist << "\n";
+            }
+        }
+    };
+
     struct xput_statistics {
         u64 offset;
-        u64 end_curr_epoch; //Ticks
+        u64 end_curr_epoch; //Ticks from offset to the end of the current epoch, i.e., to its next whole wall-clock second
+        u64 first_sec; //Wall-clock second of epoch 0
         u32 curr_epoch;
         u32 counter;
         struct timer *x_timer;
-        std::vector<struct xput_sample> samples;
         u32 id;
         u32 tics_per_usec;
-#ifdef USE_RESERVOIR
-        std::vector<std::array<reservoir, OP_LAST>> latency_reservoirs;
-        std::vector<std::array<t_reservoir<perc_s>, OP_LAST>> breakdown_reservoirs;
-#endif
+        //Epoch e is stored in ring[e % XPUT_RING_SLOTS]
+        std::vector<struct xput_epoch> ring;
+        std::atomic<u32> completed; //Epochs before this one are final. Written by the worker
+        std::atomic<u32> flushed; //Epochs before this one have been written out. Written by the flusher
+        std::atomic<bool> finished; //No epoch will be completed anymore
+        u64 stalls; //Times the worker had to wait for the flusher to free a slot
 
         ~xput_statistics() {
             delete x_timer;
         }
 
 
-        xput_statistics(u32 _id, u32 _tics_per_usec) : id(_id) {
+        xput_statistics(u32 _id, u32 _tics_per_usec) : id(_id), ring(XPUT_RING_SLOTS), completed(0), flushed(0),
+                                                       finished(false), stalls(0) {
             x_timer = new timer(_tics_per_usec);
-            // samples = (struct xput_sample *) malloc(sizeof(struct xput_sample) * XPUT_SAMPLES);
-            // if (!samples) {
-            //     FATAL("Could not allocate xput samples");
-            // }
-            // latency_reservoirs.resize(XPUT_SAMPLES);
-            // breakdown_reservoirs.resize(XPUT_SAMPLES);
             reset_xput_stats();
         }
 
+        inline struct xput_epoch &epoch(u32 e) {
+            return ring[e % XPUT_RING_SLOTS];
+        }
+
+        inline struct xput_sample &sample() {
+            return epoch(curr_epoch).sample;
+        }
+
         void reset_xput_stats() {
-            std::array<reservoir, OP_LAST> ar;
-            std::array<t_reservoir<perc_s>, OP_LAST> atr;
+            const u64 start = x_timer->ticks();
+            reset_xput_stats(start, x_timer->t_long_usec());
+        }
+
+        /*
+         * Epoch 0 starts at the given tick, which corresponds to the given wall-clock time.
+         * Epochs end on whole wall-clock seconds, so that epochs of different threads and processes cover the same
+         * second and can be summed. Hence, epoch 0 is usually shorter than a second.
+         * Must be called before the flusher can see any completed epoch
+         */
+        void reset_xput_stats(u64 start, u64 start_wall_usec) {
             curr_epoch = 0;
-            offset = x_timer->ticks();
-            end_curr_epoch = x_timer->tics_per_sec;
+            offset = start;
+            first_sec = start_wall_usec / 1000000;
+            end_curr_epoch = (1000000 - start_wall_usec % 1000000) * x_timer->tics_per_usec;
 
             counter = 0;
-            samples.push_back(xput_sample());
-            latency_reservoirs.push_back(ar);
-            breakdown_reservoirs.push_back(atr);
-            samples[curr_epoch].ops = 0;
-            samples[curr_epoch].time = 0;//0;//x_timer->t_long_sec();
-            samples[curr_epoch].cumul = 0;
-            samples[curr_epoch].debt = 0;
-            latency_reservoirs[curr_epoch][OP_INSERT].reset();
-            latency_reservoirs[curr_epoch][OP_GENERIC].reset();
-            latency_reservoirs[curr_epoch][OP_UPDATE].reset();
-            breakdown_reservoirs[curr_epoch][OP_GENERIC].reset();
-        }
-
-        inline void add_breakdown_sample(OPS op, unsigned long total, unsigned long begin, unsigned long body,
+            completed.store(0);
+            flushed.store(0);
+            finished.store(false);
+            epoch(curr_epoch).reset(0, first_sec);
+        }
+
+        //Makes the current epoch visible to the flusher. No sample can be added afterwards
+        void finish() {
+            completed.store(curr_epoch + 1, std::memory_order_release);
+            finished.store(true, std::memory_order_release);
+        }
+
+        inline void add_breakdown_sample(unsigned long total, unsigned long begin, unsigned long body,
                                          unsigned long commit) {
-            breakdown_reservoirs[curr_epoch][op].add(perc_s(total, begin, body, commit));
+            epoch(curr_epoch).breakdown.add(perc_s(total, begin, body, commit));
         }
 
         inline void add_sample(unsigned long latency, unsigned long init_time, OPS op) {
@@ -234,9 +510,9 @@ private:
              * measured by perf and by this function, bc perf likely timestamps an operation with the completion time
              */
 
-            samples[curr_epoch].ops++;
-            samples[curr_epoch].cumul += latency;
-            latency_reservoirs[curr_epoch][op].add(latency);
+            sample().ops++;
+            sample().cumul += latency;
+            epoch(curr_epoch).latency[op].add(latency);
             const u64 now = x_timer->ticks();
             const u64 elapsed_ticks = now - offset;
 
@@ -245,37 +521,41 @@ private:
             //We want to know how much time actually belongs to the other epochs we have crossed
             //just to double check that the max number of ticks per epoch is ticks_per_second
             if (elapsed_ticks >= end_curr_epoch) {
-                samples[curr_epoch].debt = latency - end_curr_epoch;
+                sample().debt = latency - end_curr_epoch;
             }
 
-            TRACE_FORMAT("SAMPLE OPS[%u][%u] = %u (%lu).", id, curr_epoch, samples[curr_epoch].ops,
-                         samples[curr_epoch].cumul);
+            TRACE_FORMAT("SAMPLE OPS[%u][%u] = %u (%lu).", id, curr_epoch, sample().ops, sample().cumul);
 
             while (elapsed_ticks >= end_curr_epoch) {
                 if (!id) {
-                    PRINT_FORMAT("OPS[%u][%u] = %u (%lu).", id, samples[curr_epoch].time,
-                                 samples[curr_epoch].ops, samples[curr_epoch].cumul);
+                    PRINT_FORMAT("OPS[%u][%u] = %u (%lu).", id, sample().time, sample().ops, sample().cumul);
                 }
                 curr_epoch++;
-                std::array<reservoir, OP_LAST> ar;
-                std::array<t_reservoir<perc_s>, OP_LAST> atr;
-                samples.push_back(xput_sample());
-                latency_reservoirs.push_back(ar);
-                breakdown_reservoirs.push_back(atr);
-                samples[curr_epoch].ops = 0;
-                samples[curr_epoch].time = curr_epoch;//x_timer->t_long_sec();
-                samples[curr_epoch].cumul = 0;
-                samples[curr_epoch].debt = 0;
-                latency_reservoirs[curr_epoch][OP_GENERIC];
-                latency_reservoirs[curr_epoch][OP_INSERT];
-                latency_reservoirs[curr_epoch][OP_INIT];
-                latency_reservoirs[curr_epoch][OP_COMMIT];
-                latency_reservoirs[curr_epoch][OP_UPDATE];
-                breakdown_reservoirs[curr_epoch][OP_GENERIC];
-                end_curr_epoch = (curr_epoch + 1) * x_timer->tics_per_sec;
+                //The slot of the new epoch must have been written out by the flusher before we can reuse it
+                while (curr_epoch - flushed.load(std::memory_order_acquire) >= XPUT_RING_SLOTS) {
+                    if (!stalls++) {
+                        PRINT_FORMAT("Thread %u waiting for the xput flusher", id);
+                    }
+                    usleep(1000);
+                }
+                epoch(curr_epoch).reset(curr_epoch, first_sec + curr_epoch);
+                completed.store(curr_epoch, std::memory_order_release);
+                end_curr_epoch = epoch_end(elapsed_ticks);
             }
         }
 
+        /*
+         * Ticks from offset to the end of the wall-clock second of the current epoch, given the ticks elapsed now.
+         * The end is re-anchored to the wall clock (CLOCK_REALTIME) at every epoch, rather than advanced by the nominal
+         * --freq, so that epoch boundaries do not drift away from wall-clock seconds in long runs. If that second is
+         * already over, the epoch ends now
+         */
+        inline u64 epoch_end(u64 elapsed_ticks) {
+            const u64 end_usec = (first_sec + curr_epoch + 1) * 1000000;
+            const u64 now_usec = x_timer->t_long_usec();
+            return now_usec >= end_usec ? elapsed_ticks : elapsed_ticks + (end_usec - now_usec) * x_timer->tics_per_usec;
+        }
+
         inline void add_sample(unsigned long latency, OPS op) {
 
             /*
@@ -284,11 +564,189 @@ private:
              * measured by perf and by this function, bc perf likely timestamps an operation with the completion time
              * //FIXME @ddi ???
              */
-            latency_reservoirs[curr_epoch][op].add(latency);
+            epoch(curr_epoch).latency[op].add(latency);
+        }
+
+        //Like the latency of the op, charged to the epoch in which the op started
+        inline void add_retry_sample(OPS op, const kv_retry_stats &r) {
+            epoch(curr_epoch).retries[op].add(r);
+        }
+
+        inline void add_load_sample(u64 bytes) {
+            sample().load_bytes += bytes;
+        }
+
+        inline void add_delete_sample(u64 deleted, u64 reinserted) {
+            sample().deleted_keys += deleted;
+            sample().reinserted_keys += reinserted;
         }
 
+        inline void add_grv_sample(u64 requests, u64 stale) {
+            sample().grv_requests += requests;
+            sample().grv_stale += stale;
+        }
+
+        //Charged to the epoch in which the scan started, like its latency
+        inline void add_scan_sample(u64 rows, u64 bytes) {
+            sample().scan_rows += rows;
+            sample().scan_bytes += bytes;
+        }
+
+        /*
+         * Records the service time of an op next to its latency corrected for coordinated omission.
+         * If expected_interval is not 0 (closed loop with think time), we do not know the intended start time of the
+         * ops that should have been issued while this one was stalled, so we back-fill them like HdrHistogram does:
+         * one synthetic sample every expected_interval ticks, with linearly decreasing latency.
+         * Must be called before add_sample, so that the samples are charged to the epoch in which the op started
+         */
+        inline void add_co_sample(unsigned long corrected, unsigned long service, unsigned long expected_interval) {
+            struct xput_epoch &e = epoch(curr_epoch);
+            e.service.add(service);
+            e.corrected.add(corrected);
+            if (expected_interval) {
+                for (unsigned long l = corrected; l > expected_interval;) {
+                    l -= expected_interval;
+                    e.corrected.add(l);
+                }
+            }
+        }
     };
 
+    struct async_engine;
+
+    /*
+     * A generic transaction run asynchronously (--tx_in_flight > 1). The slot owns the buffers of the transaction,
+     * so they stay valid until the backend signals the completion.
+     * The fields after "start" are written by the completion callback, and read by the worker after it has
+     * dequeued the slot from the completion queue
+     */
+    struct async_slot {
+        struct async_engine *engine;
+        char *keys;
+        bool *rw;
+        u8 *flags;
+        size_t *key_sizes, *value_sizes;
+        char **put_ptr;
+        u64 intended, start;
+        u64 end, begin_latency, commit_latency;
+        u64 alloc_latency; //Set by the worker when the transaction is issued
+        kv_retry_stats retries;
+        int rc;
+    };
+
+    struct async_engine {
+        std::vector<struct async_slot> slots;
+        std::vector<struct async_slot *> free_slots; //Only accessed by the worker
+        std::mutex lock;
+        std::condition_variable cv;
+        std::vector<struct async_slot *> completed; //Protected by lock
+
+        async_engine(u32 in_flight, u32 generic_ops, u32 key_size) : slots(in_flight) {
+            for (struct async_slot &slot : slots) {
+                slot.engine = this;
+                slot.keys = (char *) malloc(generic_ops * key_size);
+                slot.rw = (bool *) malloc(generic_ops * sizeof(bool));
+                slot.flags = (u8 *) malloc(generic_ops * sizeof(u8));
+                slot.key_sizes = (size_t *) malloc(generic_ops * sizeof(size_t));
+                slot.value_sizes = (size_t *) malloc(generic_ops * sizeof(size_t));
+                slot.put_ptr = (char **) malloc(generic_ops * sizeof(char *));
+                if (slot.keys == nullptr || slot.rw == nullptr || slot.flags == nullptr || slot.key_sizes == nullptr ||
+                    slot.value_sizes == nullptr || slot.put_ptr == nullptr) {
+                    FATAL("Error in building buffers for asynchronous generic ops");
+                }
+                free_slots.push_back(&slot);
+            }
+            completed.reserve(in_flight);
+        }
+
+        ~async_engine() {
+            for (struct async_slot &slot : slots) {
+                free(slot.keys);
+                free(slot.rw);
+                free(slot.flags);
+                free(slot.key_sizes);
+                free(slot.value_sizes);
+                free(slot.put_ptr);
+            }
+        }
+
+        bool idle() const {
+            return free_slots.size() == slots.size();
+        }
+    };
+
+    struct bulk_engine;
+
+    /*
+     * Keys and values of a bulk insert. The values point to the buffer of the value builder of the thread, so they are
+     * not copied. The fields after "start" are written by the completion callback, as in async_slot
+     */
+    struct bulk_batch {
+        struct bulk_engine *engine;
+        char *keys;
+        size_t *key_sizes, *value_sizes;
+        char **values;
+        u32 num_keys;
+        u64 bytes;
+        u64 start;
+        u64 end;
+        kv_retry_stats retries;
+        int rc;
+    };
+
+    //Bulk inserts of a population thread, with up to --bulk_in_flight of them committing at the same time
+    struct bulk_engine {
+        std::vector<struct bulk_batch> batches;
+        std::vector<struct bulk_batch *> free_batches; //Only accessed by the population thread
+        std::mutex lock;
+        std::condition_variable cv;
+        std::vector<struct bulk_batch *> completed; //Protected by lock
+        u32 max_keys; //Keys per bulk insert
+        u64 max_bytes; //Bytes (keys + values) per bulk insert: --bulk_bytes if set, otherwise MAX_BULK_BYTES
+
+        /*
+         * With --bulk_bytes, a bulk insert is only bound by its bytes, so it has as many keys as records of min_record
+         * bytes fit in them. A bulk insert goes over max_bytes by at most its last record, whose key is at most
+         * max_key_size bytes
+         */
+        bulk_engine(u32 in_flight, u32 bulk_keys, u64 bulk_bytes, size_t min_record, size_t max_key_size) :
+                batches(in_flight), max_bytes(bulk_bytes ? bulk_bytes : MAX_BULK_BYTES) {
+            const u64 fitting = (max_bytes + min_record - 1) / min_record;
+            max_keys = (u32) (bulk_bytes || fitting < bulk_keys ? fitting : bulk_keys);
+            const size_t keys_size = std::min((size_t) max_keys * max_key_size, (size_t) max_bytes + max_key_size);
+            for (struct bulk_batch &b : batches) {
+                b.engine = this;
+                b.keys = (char *) malloc(keys_size);
+                b.key_sizes = (size_t *) malloc(max_keys * sizeof(size_t));
+                b.value_sizes = (size_t *) malloc(max_keys * sizeof(size_t));
+                b.values = (char **) malloc(max_keys * sizeof(char *));
+                if (b.keys == nullptr || b.key_sizes == nullptr || b.value_sizes == nullptr || b.values == nullptr) {
+                    FATAL("Error in building buffers for bulk inserts");
+                }
+                free_batches.push_back(&b);
+            }
+            completed.reserve(in_flight);
+        }
+
+        ~bulk_engine() {
+            for (struct bulk_batch &b : batches) {
+                free(b.keys);
+                free(b.key_sizes);
+                free(b.value_sizes);
+                free(b.values);
+            }
+        }
+
+        bool idle() const {
+            return free_batches.size() == batches.size();
+        }
+    };
+
+    //A key deleted by a thread, to be inserted back once the thread has done "due" ops
+    struct deleted_key {
+        u64 due;
+        std::string key;
+    };
 
     struct fkvb_thread_state {
 
@@ -296,10 +754,15 @@ private:
 #define VALUE_BUFFER_SIZE (1UL<<16)
         struct io_pattern *key_index_generator;
         struct io_pattern *scan_length_generator;
+        struct io_pattern *clear_range_length_generator = nullptr;
         struct io_pattern *batch_size_generator;
         struct io_pattern *value_size_generator;
         struct next_op_pattern *next_op_generator;
         struct next_op_pattern *secondary_next_op_generator;
+        struct arrival_pattern *arrival = nullptr; //Only set in open-loop mode
+        struct async_engine *async = nullptr; //Only set with more than one transaction in flight
+        struct bulk_engine *bulk = nullptr; //Only set for population threads that insert more than one key per tx
+        u64 loaded_keys = 0, loaded_bytes = 0;
         struct xput_statistics *xput_stats;
 
         u32 id, client_id;
@@ -309,7 +772,7 @@ private:
         u32 generic_ops;
         OPS last_op;
 
-        prefix_key_string_builder *key_builder;
+        KeyEncoder *key_builder;
         value_string_builder_rnd *value_builder;
 
         size_t buffer_size_value = VALUE_BUFFER_SIZE;
@@ -320,25 +783,35 @@ private:
         char key_buffer2[KEY_BUFFER_SIZE]; //For end_key in scans
         char value_buffer[VALUE_BUFFER_SIZE];
 
-        //Stores the keys for a bulk update
-        char key_buffer_bulk[KEY_BUFFER_SIZE * BULK_SIZE];
-        //Stores the values for a bulk update
-        char value_buffer_bulk[VALUE_BUFFER_SIZE * BULK_SIZE];
-        //Stores the pointers to the values for a bulk update.
-        //Since we do not actually generate new values, these pointers point to addresses within the static value buffer
-        //Unused for now
-        char value_buffer_bulk_ptrs[BULK_SIZE];
-        size_t key_sizes_bulk[BULK_SIZE];
-        size_t value_sizes_bulk[BULK_SIZE];
         KVOrdered <IO> *kv;//ptr to the kv store
 
         u32 num_keys;//number of keys to insert upon load
         volatile bool running = true;
 
-        char *generic_key_buffer, *generic_putvalue_buffer, *generic_getvalue_buffer;
+        char *generic_key_buffer;
+        //Values read by generic transactions. Grown by the KV to fit the largest ones
+        std::vector<char> generic_get_buffer;
+        std::vector<char *> generic_read_ptrs;
         bool *generic_rw;
+        u8 *generic_flags = nullptr; //KV_OP_* options of each op
         size_t *generic_key_sizes, *generic_value_sizes;
         char **generic_put_ptr, **generic_get_ptr;
+        //Draws the options of the ops of generic transactions. Only set if any of them is enabled
+        struct rand_io_pattern *options_rnd = nullptr;
+        u8 snapshot_perc = 0, no_conflict_perc = 0, conflict_perc = 0, atomic_perc = 0;
+
+        //Operand of atomic mutations, and generator of their keys if they only go to --atomic_keys keys
+        char *atomic_operand = nullptr;
+        size_t atomic_size = 0;
+        struct rand_io_pattern *atomic_key_generator = nullptr;
+
+        //Keys deleted by the thread, oldest first, and buffers to insert them back
+        std::deque<struct deleted_key> deleted;
+        u64 ops_done = 0;
+        u32 reinsert_delay = 0;
+        std::string reinsert_keys;
+        std::vector<size_t> reinsert_key_sizes, reinsert_value_sizes;
+        std::vector<char *> reinsert_values;
 
 
         fkvb_thread_state(u32 _id, u32 cid, u32 freq) : id(_id), client_id(cid) {
@@ -350,14 +823,20 @@ private:
         ~fkvb_thread_state() {
             delete key_index_generator;
             delete scan_length_generator;
+            delete clear_range_length_generator;
             delete batch_size_generator;
             delete value_size_generator;
             delete next_op_generator;
+            delete arrival;
+            delete async;
+            delete bulk;
+            delete options_rnd;
+            delete atomic_key_generator;
             delete op_timer;
             free(generic_key_buffer);
-            free(generic_putvalue_buffer);
-            free(generic_getvalue_buffer);
             free(generic_rw);
+            free(generic_flags);
+            free(atomic_operand);
             free(generic_key_sizes);
 #ifdef TRACE_PERF
             delete latency_reservoir;
@@ -405,67 +884,111 @@ private:
             xput_stats->add_sample(l, op);
         }
 
-        inline void add_breakdown_sample(OPS op, unsigned long t, unsigned long s, unsigned long b, unsigned long c) {
-            xput_stats->add_breakdown_sample(op, t, s, b, c);
+        /*
+         * Charges to the last op the time between its intended start and the actual one, if any (open loop),
+         * and records both the measured and the corrected latency. After this call, last_duration and last_init
+         * refer to the intended start of the op
+         */
+        inline void correct_latency(u64 intended, u64 expected_interval) {
+            const u64 service = last_duration;
+            if (intended) {
+                last_duration += last_init - intended;
+                last_init = intended;
+            }
+            xput_stats->add_co_sample(last_duration, service, expected_interval);
+        }
+
+        inline void add_breakdown_sample(unsigned long t, unsigned long s, unsigned long b, unsigned long c) {
+            xput_stats->add_breakdown_sample(t, s, b, c);
+        }
+
+        //Records the attempts of the last op and resets them
+        inline void add_retry_sample(kv_retry_stats &r) {
+            xput_stats->add_retry_sample(last_op, r);
+            r.reset();
         }
+    };
 
-        void dump_xputs(const char *file) {
-            TRACE_FORMAT("DUMPING THREAD %u to %s", id, file);
-            u32 i;
-            std::ofstream myfile(file, std::fstream::app | std::fstream::out);
-            if (myfile.fail()) {
-                PRINT_FORMAT("Error opening %s", file);
+    //Max seconds for which a per-process aggregate waits for a thread that does not complete them (e.g., stuck op)
+#define XPUT_AGGREGATE_WINDOW 60
+
+    /*
+     * Reporter of a set of threads: while they run, writes out the epochs they complete, and the per-process
+     * aggregate of each wall-clock second once all threads have completed it.
+     * An aggregate is written once: the epochs of a second that has already been written out (a thread lagging more
+     * than the window) are folded into a correction of that second, written at the end as a "late" line
+     */
+    struct xput_flusher {
+        struct fkvb_thread_state **states;
+        u32 num_states;
+        std::ofstream xput, hist, retry;
+        std::atomic<bool> done;
+        pthread_t thread;
+        std::map<u64, struct xput_epoch *> pending; //Aggregates by wall-clock second, not written out yet
+        std::map<u64, struct xput_epoch *> late; //Corrections of the seconds already written out
+        u64 written_until = 0; //The aggregates of the seconds before this one have been written out
+        u64 late_epochs = 0;
+
+        xput_flusher(struct fkvb_thread_state **_states, u32 num, const std::string &xput_file,
+                     const std::string &hist_file, const std::string &retry_file) :
+                states(_states), num_states(num), xput(xput_file.c_str(), std::fstream::app | std::fstream::out),
+                hist(hist_file.c_str(), std::fstream::app | std::fstream::out),
+                retry(retry_file.c_str(), std::fstream::app | std::fstream::out), done(false) {
+            if (xput.fail() || hist.fail() || retry.fail()) {
+                ERROR("Error opening %s, %s or %s", xput_file.c_str(), hist_file.c_str(), retry_file.c_str());
                 throw std::ios_base::failure(std::strerror(errno));
             }
-            for (i = 0; i <= xput_stats->curr_epoch; i++) {
-                xput_stats->latency_reservoirs[i][OP_INSERT].sort();
-                xput_stats->latency_reservoirs[i][OP_GENERIC].sort();
-                xput_stats->latency_reservoirs[i][OP_UPDATE].sort();
-                reservoir &r_i = xput_stats->latency_reservoirs[i][OP_INSERT];
-                reservoir &r_g = xput_stats->latency_reservoirs[i][OP_GENERIC];
-                reservoir &r_u = xput_stats->latency_reservoirs[i][OP_UPDATE];
-
-                xput_stats->latency_reservoirs[i][OP_INIT].sort();
-                xput_stats->latency_reservoirs[i][OP_COMMIT].sort();
-                reservoir &r_in = xput_stats->latency_reservoirs[i][OP_INIT];
-                reservoir &r_co = xput_stats->latency_reservoirs[i][OP_COMMIT];
-                t_reservoir<perc_s> &bg = xput_stats->breakdown_reservoirs[i][OP_GENERIC];
-                bg.sort();
-
-                perc_s p50 = bg.get_percentile(0.5);
-                perc_s p99 = bg.get_percentile(0.99);
-
-                myfile << id << " "
-                       << xput_stats->samples[i].time << " "
-                       << xput_stats->samples[i].ops << " "
-                       << xput_stats->samples[i].cumul << " "
-                       << xput_stats->samples[i].debt << " "
-                       << r_i.get_percentile(0.5) << " "
-                       << r_i.get_percentile(0.99) << " "
-                       << r_g.get_percentile(0.5) << " "
-                       << r_g.get_percentile(0.99) << " "
-                       << r_in.get_avg() << " "
-                       << r_in.get_percentile(0.5) << " "
-                       << r_in.get_percentile(0.99) << " "
-                       << r_co.get_avg() << " "
-                       << r_co.get_percentile(0.5) << " "
-                       << r_co.get_percentile(0.99) << " "
-                       << r_u.get_avg() << " "
-                       << r_u.get_percentile(0.5) << " "
-                       << r_u.get_percentile(0.99) << " "
-                       << p50.start << " "
-                       << p50.commit << " "
-                       << p50.total << " "
-                       << p99.start << " "
-                       << p99.commit << " "
-                       << p99.total << "\n";
-
-                TRACE_FORMAT("%u %u %u %lu %lu", id, xput_stats->samples[i].time, xput_stats->samples[i].ops,
-                             xput_stats->samples[i].cumul, xput_stats->samples[i].debt);
-                myfile.flush();
+        }
+
+        ~xput_flusher() {
+            for (auto &p: pending) {
+                delete p.second;
+            }
+            for (auto &p: late) {
+                delete p.second;
+            }
+        }
+
+        static void merge_into(std::map<u64, struct xput_epoch *> &aggs, const struct xput_epoch &e) {
+            struct xput_epoch *&agg = aggs[e.sample.wall_sec];
+            if (agg == nullptr) {
+                agg = new xput_epoch();
+                agg->reset(e.sample.time, e.sample.wall_sec);
+                agg->threads = 0;
+            }
+            agg->merge(e);
+        }
+
+        //Moves a completed epoch of a thread into the aggregate of its second, or into its correction if late
+        void aggregate(const struct xput_epoch &e) {
+            if (e.sample.wall_sec < written_until) {
+                merge_into(late, e);
+                late_epochs++;
+            } else {
+                merge_into(pending, e);
+            }
+        }
+
+        //Writes out the aggregates of the seconds before until, and the oldest ones beyond the window
+        void write_aggregates(u64 until) {
+            while (!pending.empty() && (pending.begin()->first < until || pending.size() > XPUT_AGGREGATE_WINDOW)) {
+                pending.begin()->second->write("proc", xput, hist, retry);
+                written_until = pending.begin()->first + 1;
+                delete pending.begin()->second;
+                pending.erase(pending.begin());
+            }
+        }
+
+        //Writes out the corrections, once all threads are done
+        void write_corrections() {
+            if (!late_epochs) {
+                return;
+            }
+            ERROR("%lu epochs of %zu seconds completed after the aggregate of their second was written: written as "
+                  "\"late\" lines, not included in the \"proc\" lines", late_epochs, late.size());
+            for (auto &p: late) {
+                p.second->write("late", xput, hist, retry);
             }
-            myfile.close();
-            TRACE_FORMAT("DUMPED THREAD %u to %s", id, file);
         }
     };
 
@@ -493,12 +1016,49 @@ private:
 
     static int do_generic(fkvb_thread_state *state);
 
-    static int do_populate_bulk(fkvb_thread_state *state, u32 ops);
+    static int do_atomic(fkvb_thread_state *state);
+
+    static int do_delete(fkvb_thread_state *state);
+
+    static int do_clear_range(fkvb_thread_state *state);
+
+    static int do_reinsert(fkvb_thread_state *state, bool all);
+
+    static void reinsert_deleted(fkvb_thread_state *state, bool all);
+
+    static void build_generic(fkvb_thread_state *state, char *keys, size_t *key_sizes, bool *rw, u8 *flags,
+                              char **put_ptr, size_t *value_sizes);
+
+    static void on_async_complete(void *ctx, int rc, uint64_t begin_latency, uint64_t commit_latency,
+                                  const kv_retry_stats &retries);
+
+    static void async_loop(fkvb_thread_state *state);
+
+    static void build_bulk(fkvb_thread_state *state, struct bulk_batch *b, u32 max_keys, u64 max_bytes);
+
+    static void report_population(fkvb_thread_state *state, u32 remaining, u32 &done, u32 &print_stats, u32 rollout);
+
+    static int do_populate_bulk(fkvb_thread_state *state, struct bulk_batch *b);
+
+    static void record_bulk(fkvb_thread_state *state, struct bulk_batch *b, kv_retry_stats &retries);
+
+    static void on_bulk_complete(void *ctx, int rc, uint64_t begin_latency, uint64_t commit_latency,
+                                 const kv_retry_stats &retries);
+
+    static void populate_bulk_loop(fkvb_thread_state *state, u32 ops, u32 rollout);
+
+    static u64 wait_next_arrival(fkvb_thread_state *state);
+
+    static void wait_start(fkvb_thread_state *state);
 
     static void *tx_loop(void *state);
 
     static void *populate_loop(void *state);
 
+    static void *flush_loop(void *flusher);
+
+    u64 count_keys(fkvb_thread_state **sts, u32 num_states);
+
     void sigusr1_handler(int s);
 
     void sigusr2_handler(int s);
@@ -9,8 +9,14 @@
  */
 
 #include "KVOrderedFDB.hh"
+#include <atomic>
+#include <chrono>
+#include <unistd.h>
 
 #define MAX_RETRY 10
+#define FDB_ERROR_TX_TOO_OLD 1007
+#define FDB_ERROR_FUTURE_VERSION 1009
+#define FDB_ERROR_NOT_COMMITTED 1020
 
 //Maybe if I explicitly set some configs with the API, I cannot log by simply using
 //FDB_NETWORK_OPTION_TRACE_ENABLE
@@ -25,10 +31,20 @@ thread_local char tx_sid[20];
 #endif
 extern thread_local u32 tid; //for debugging purposes only
 
-extern thread_local uint64_t zrl_fkvb_begin_latency, zrl_fkvb_commit_latency,  last_grv_wallclock;
+extern thread_local uint64_t zrl_fkvb_begin_latency, zrl_fkvb_commit_latency;
+extern thread_local uint64_t zrl_fkvb_scan_rows, zrl_fkvb_scan_bytes;
+extern thread_local uint64_t zrl_fkvb_tx_alloc_latency, zrl_fkvb_grv_requests, zrl_fkvb_grv_stale;
+extern thread_local kv_retry_stats zrl_fkvb_retries;
 extern u64 grv_cache_tics_ms;
-thread_local int64_t last_grv;
-thread_local u64 last_grv_wallclock=0;
+//GRV cache of the thread. Asynchronous transactions update it from the network thread on behalf of the worker thread
+static thread_local fdb_grv_cache local_grv;
+//GRV cache of the process (--grv_cache_shared), only updated by the refresher thread
+static fdb_grv_cache shared_grv;
+static bool grv_shared = false;
+static std::atomic<bool> grv_refresher_stop(false);
+static useconds_t grv_refresh_us;
+//Transaction handles of this thread (and of its asynchronous transactions)
+static thread_local fdb_tx_pool tx_pool;
 fdb_error_t waitError(FDBFuture *f);
 
 void *runNetwork(void *params);
@@ -54,6 +70,91 @@ static void checkError(fdb_error_t err, const char *context) {
     }
 }
 
+//Returns true, and the version in grv, if a cached read version not older than grv_cache_tics_ms can be used
+static inline bool cached_grv(fdb_grv_cache *local, u64 now, int64_t &grv) {
+    fdb_grv_cache *c = grv_shared ? &shared_grv : local;
+    const u64 wallclock = c->wallclock.load(std::memory_order_acquire);
+    if (!wallclock || (now - wallclock) > grv_cache_tics_ms ||
+        wallclock == local->rejected.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    grv = c->grv.load(std::memory_order_relaxed);
+    return true;
+}
+
+//requested is the time at which the GRV was requested, so that the age of a cached version is never underestimated
+static inline void cache_grv(fdb_grv_cache *local, u64 requested, int64_t grv) {
+    if (grv_shared) {
+        return;
+    }
+    local->grv.store(grv, std::memory_order_relaxed);
+    local->wallclock.store(requested, std::memory_order_release);
+}
+
+//The read version was rejected by the cluster: retrying with the same cached version would fail again
+static inline bool stale_grv_error(fdb_error_t e) {
+    return e == FDB_ERROR_TX_TOO_OLD || e == FDB_ERROR_FUTURE_VERSION;
+}
+
+static inline void count_error(kv_retry_stats &retries, fdb_error_t e) {
+    if (e == FDB_ERROR_NOT_COMMITTED) {
+        retries.conflicts++;
+    } else {
+        retries.errors.push_back(e);
+    }
+}
+
+/*
+ * The next transaction of the thread gets a new GRV. The shared cache is only written by the refresher, so the thread
+ * bypasses it until the refresher publishes a new version
+ */
+static inline void invalidate_grv(fdb_grv_cache *local) {
+    if (grv_shared) {
+        local->rejected.store(shared_grv.wallclock.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    } else {
+        local->wallclock.store(0, std::memory_order_relaxed);
+    }
+}
+
+/*
+ * Refreshes the shared GRV cache at a fixed cadence: a GRV is requested every grv_cache_ms/2, whatever its latency.
+ * A version is stamped with the time it was requested, so the cached version is always younger than grv_cache_ms
+ * unless a GRV takes longer than grv_cache_ms/2. In that case, threads get their own GRV until the next refresh, and
+ * the next GRV is requested as soon as the late one completes.
+ */
+static void *runGrvRefresher(void *params) {
+    FDBTransaction *tr = (FDBTransaction *) params;
+    const std::chrono::microseconds period(grv_refresh_us);
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+    while (!grv_refresher_stop.load(std::memory_order_relaxed)) {
+        const u64 init = ticks::get_ticks();
+        next += period;
+        int64_t grv;
+        fdb_transaction_reset(tr);
+        FDBFuture *f = fdb_transaction_get_read_version(tr);
+        fdb_error_t e = fdb_future_block_until_ready(f);
+        if (!e) {
+            e = fdb_future_get_int64(f, &grv);
+        }
+        fdb_future_destroy(f);
+        if (e) {
+            ERROR("GRV refresher: %s", fdb_get_error(e));
+        } else {
+            shared_grv.grv.store(grv, std::memory_order_relaxed);
+            shared_grv.wallclock.store(init, std::memory_order_release);
+        }
+        //The time taken by the GRV is part of the period
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (now < next) {
+            usleep((useconds_t) std::chrono::duration_cast<std::chrono::microseconds>(next - now).count());
+        } else {
+            next = now; //Late: no burst of GRVs to catch up
+        }
+    }
+    fdb_transaction_destroy(tr);
+    return NULL;
+}
+
 void *runNetwork(void *params) {
     if (fdb_run_network()) {
         FATAL("FDB_RUN_NETWORK FAILED");
@@ -117,10 +218,39 @@ FDBDatabase *openDatabase(pthread_t *netThread, std::string &cluster_file, std::
 
 int run_fdb_op(fdb_op_g *op, FDBDatabase *db);
 
+void run_fdb_op_async(fdb_async_generic *tx);
+
+
+static FDBStreamingMode streaming_mode(const std::string &mode) {
+    if (mode == "want_all") return FDB_STREAMING_MODE_WANT_ALL;
+    if (mode == "iterator") return FDB_STREAMING_MODE_ITERATOR;
+    if (mode == "exact") return FDB_STREAMING_MODE_EXACT;
+    if (mode == "small") return FDB_STREAMING_MODE_SMALL;
+    if (mode == "medium") return FDB_STREAMING_MODE_MEDIUM;
+    if (mode == "large") return FDB_STREAMING_MODE_LARGE;
+    if (mode == "serial") return FDB_STREAMING_MODE_SERIAL;
+    FATAL("Unknown streaming mode %s", mode.c_str());
+}
+
+static FDBMutationType mutation_type(const std::string &op) {
+    if (op == "add") return FDB_MUTATION_TYPE_ADD;
+    if (op == "and") return FDB_MUTATION_TYPE_BIT_AND;
+    if (op == "or") return FDB_MUTATION_TYPE_BIT_OR;
+    if (op == "xor") return FDB_MUTATION_TYPE_BIT_XOR;
+    if (op == "max") return FDB_MUTATION_TYPE_MAX;
+    if (op == "min") return FDB_MUTATION_TYPE_MIN;
+    if (op == "byte_max") return FDB_MUTATION_TYPE_BYTE_MAX;
+    if (op == "byte_min") return FDB_MUTATION_TYPE_BYTE_MIN;
+    if (op == "append_if_fits") return FDB_MUTATION_TYPE_APPEND_IF_FITS;
+    FATAL("Unknown atomic op %s", op.c_str());
+}
 
 template<typename IO>
 KVOrderedFDB<IO>::KVOrderedFDB(fkvb_test_conf *cconf) {
     conf = cconf;
+    scan_mode = streaming_mode(conf->scan_mode);
+    atomic_op = mutation_type(conf->atomic_op);
+    missing_ok = conf->delete_perc || conf->clear_range_perc;
 };
 
 
@@ -133,6 +263,7 @@ int
 KVOrderedFDB<IO>::get(const char key[], size_t key_size, char *val_buff, size_t val_buff_size,
                       size_t &val_size_read, size_t &val_size) {
     op_params_get params = op_params_get((char *) &key[0], key_size, val_buff, val_buff_size);
+    params.missing_ok = missing_ok;
     fdb_op_get op_get = fdb_op_get(&params);
     int rc = run_fdb_op(&op_get, db);
     if (rc) {
@@ -147,8 +278,12 @@ KVOrderedFDB<IO>::get(const char key[], size_t key_size, char *val_buff, size_t
 
 template<typename IO>
 int KVOrderedFDB<IO>::shutdown() {
-    //No-op. Needs to be killed from the outside
+    //Needs to be killed from the outside
     //delete db;
+    if (grv_shared) {
+        grv_refresher_stop = true;
+        pthread_join(_grvThread, NULL);
+    }
     return 0;
 }
 
@@ -164,6 +299,18 @@ int KVOrderedFDB<IO>::init() {
     if (db == nullptr) {
         FATAL("DB IS NULL");
     }
+    if (conf->grv_cache_shared) {
+        FDBTransaction *tr;
+        checkError(fdb_database_create_transaction(db, &tr), "create transaction");
+        grv_shared = true;
+        grv_refresh_us = conf->grv_cache_ms * 500;
+        pthread_create(&_grvThread, NULL, &runGrvRefresher, tr);
+        //Threads never have to wait for a GRV, not even the first one
+        while (!shared_grv.wallclock.load(std::memory_order_acquire)) {
+            usleep(100);
+        }
+        PRINT_FORMAT("Shared GRV cache refreshed every %u us", grv_refresh_us);
+    }
 
     /*
     PRINT_FORMAT("Clearing range");
@@ -178,16 +325,15 @@ int KVOrderedFDB<IO>::init() {
 
 
 template<typename IO>
-int KVOrderedFDB<IO>::put_bulk(size_t numkv, char *k_ptr, size_t *k_sizes, char *v_ptrs, size_t *v_sizes) {
+int KVOrderedFDB<IO>::put_bulk(size_t numkv, char *k_ptr, size_t *k_sizes, char **v_ptrs, size_t *v_sizes) {
 
     /*
     size_t i;
     int rc;
-    char *k = k_ptr, *v = v_ptrs;
+    char *k = k_ptr;
     for (i = 0; i < numkv; i++) {
-        rc = put(k, k_sizes[i], v, v_sizes[i]);
+        rc = put(k, k_sizes[i], v_ptrs[i], v_sizes[i]);
         k += k_sizes[i];
-        v += v_sizes[i];
         if (rc)return rc;
     }
      */
@@ -203,6 +349,20 @@ int KVOrderedFDB<IO>::put_bulk(size_t numkv, char *k_ptr, size_t *k_sizes, char
     return ret;
 }
 
+template<typename IO>
+int KVOrderedFDB<IO>::put_bulk_async(size_t numkv, char *k_ptr, size_t *k_sizes, char **v_ptrs, size_t *v_sizes,
+                                     kv_async_cb cb, void *ctx) {
+    fdb_async_generic *tx = new fdb_async_generic((int) numkv, nullptr, k_ptr, k_sizes, v_ptrs, v_sizes, cb, ctx,
+                                                  &local_grv);
+    tx->bulk = true;
+    tx->tr = tx_pool.get(db);
+    tx->pool = &tx_pool;
+    zrl_fkvb_grv_requests += local_grv.requests.exchange(0, std::memory_order_relaxed);
+    zrl_fkvb_grv_stale += local_grv.stale.exchange(0, std::memory_order_relaxed);
+    run_fdb_op_async(tx);
+    return 0;
+}
+
 template<typename IO>
 int KVOrderedFDB<IO>::put(const char key[], size_t key_size, const char *val, size_t val_size) {
     op_params_put params = op_params_put((char *) &key[0], key_size, val, val_size);
@@ -217,75 +377,76 @@ int KVOrderedFDB<IO>::put(const char key[], size_t key_size, const char *val, si
 }
 
 template<typename IO>
-int KVOrderedFDB<IO>::generic(int num_op, bool *rw, char *keys, size_t *key_sizes, char **put_values,
-                              size_t *put_value_sizes, char *get_buffer, size_t get_buffer_size, size_t *read_values,
-                              std::vector<char *> &read_values_ptr) {
-    op_params_generic params = op_params_generic(num_op, rw, keys, key_sizes, put_values, put_value_sizes, get_buffer,
-                                                 get_buffer_size, read_values, read_values_ptr, generic_futures);
+int KVOrderedFDB<IO>::generic(int num_op, bool *rw, uint8_t *flags, char *keys, size_t *key_sizes,
+                              char **put_values, size_t *put_value_sizes, std::vector<char> &get_buffer,
+                              size_t *read_values, std::vector<char *> &read_values_ptr) {
+    op_params_generic params = op_params_generic(num_op, rw, flags, keys, key_sizes, put_values, put_value_sizes,
+                                                 get_buffer, read_values, read_values_ptr, generic_futures);
+    params.atomic_op = atomic_op;
+    params.missing_ok = missing_ok;
     fdb_op_generic op = fdb_op_generic(&params);
     return run_fdb_op(&op, db);
 }
 
 template<typename IO>
-int KVOrderedFDB<IO>::del(const char key[], size_t key_size) {
-    NOT_IMPLEMENTED
-    //We have to do implement it with the new structure
-    FDBTransaction *tr = NULL;
-    fdb_error_t e = fdb_database_create_transaction(db, &tr);
-    checkError(e, "create transaction");
-    unsigned int maxR = MAX_RETRY;
-    while (maxR--) {
-        TRACE_FORMAT("Deleting key %s with size", key, key_size,);
-        fdb_transaction_clear(tr, (uint8_t const *) key, key_size);
-
-        FDBFuture *f = fdb_transaction_commit(tr);
-        e = waitError(f);
-        fdb_future_destroy(f);
+int KVOrderedFDB<IO>::generic_async(int num_op, bool *rw, uint8_t *flags, char *keys, size_t *key_sizes,
+                                    char **put_values, size_t *put_value_sizes, kv_async_cb cb, void *ctx) {
+    fdb_async_generic *tx = new fdb_async_generic(num_op, rw, keys, key_sizes, put_values, put_value_sizes, cb, ctx,
+                                                  &local_grv);
+    tx->flags = flags;
+    tx->atomic_op = atomic_op;
+    tx->missing_ok = missing_ok;
+    //The transaction is given back by the network thread, so only getting it is charged to this op
+    const u64 init = ticks::get_ticks();
+    tx->tr = tx_pool.get(db);
+    tx->pool = &tx_pool;
+    zrl_fkvb_tx_alloc_latency = ticks::get_ticks() - init;
+    //GRVs requested by the transactions of this thread since the last one was issued, also from the network thread
+    zrl_fkvb_grv_requests += local_grv.requests.exchange(0, std::memory_order_relaxed);
+    zrl_fkvb_grv_stale += local_grv.stale.exchange(0, std::memory_order_relaxed);
+    run_fdb_op_async(tx);
+    return 0;
+}
 
+template<typename IO>
+int KVOrderedFDB<IO>::del(const char key[], size_t key_size) {
+    op_params_del params = op_params_del(key, key_size);
+    fdb_op_del op_del = fdb_op_del(&params);
+    const int rc = run_fdb_op(&op_del, db);
+    if (rc) {
+        TRACE_FORMAT("Error when deleting %.*s", (int) key_size, key);
+    }
+    return rc;
+}
 
-        if (e) {
-            f = fdb_transaction_on_error(tr, e);
-            fdb_error_t retryE = waitError(f);
-            fdb_future_destroy(f);
-            if (retryE) {
-                fdb_transaction_destroy(tr);
-                FATAL("Unexpected error while doing DEL")
-            } else {
-                //Going to loop over and retry the operation
-            }
-        } else {
-            //Ok. Transaction committed
-            fdb_transaction_destroy(tr);
-            return 0;
-        }
+template<typename IO>
+int KVOrderedFDB<IO>::clear_range(const char start_key[], size_t start_key_size, size_t max_keys,
+                                  std::string &deleted_keys, std::vector<size_t> &deleted_key_sizes) {
+    op_params_clear_range params = op_params_clear_range(start_key, start_key_size, max_keys);
+    fdb_op_clear_range op = fdb_op_clear_range(&params);
+    const int rc = run_fdb_op(&op, db);
+    if (!rc) {
+        deleted_keys.append(params.keys);
+        deleted_key_sizes.insert(deleted_key_sizes.end(), params.key_sizes.begin(), params.key_sizes.end());
     }
-    FATAL("Could not perform single DEL in %u attempts", MAX_RETRY);
+    return rc;
 }
 
 template<typename IO>
 unsigned long KVOrderedFDB<IO>::get_size() const {
-    op_params_num_keys params = op_params_num_keys();
+    return count_keys(std::vector<std::string>());
+}
 
+template<typename IO>
+unsigned long KVOrderedFDB<IO>::count_keys(const std::vector<std::string> &boundaries) const {
+    op_params_num_keys params = op_params_num_keys(boundaries);
     fdb_op_num_keys num = fdb_op_num_keys(&params);
-    u32 keys = 0;
-    while (1) {
-        int rc = run_fdb_op(&num, db);
-        if (!rc) {
-            PRINT_FORMAT("Number of keys is %zu", params.num_keys);
-            break;
-        } else {
-            PRINT_FORMAT("SUMMING %zu", params.num_keys);
-            keys += params.num_keys;
-        }
-    }
-    return (unsigned long) params.num_keys;
-    int ret;
-    if (!(ret = run_fdb_op(&num, db))) {
-        PRINT_FORMAT("Number of keys is %zu", params.num_keys);
-    } else {
+    //Retriable errors are retried by run_fdb_op from where the walks stopped, the others are fatal
+    if (run_fdb_op(&num, db)) {
         FATAL("ERROR while counting number of keys");
     }
-    return (unsigned long) params.num_keys;
+    TRACE_FORMAT("Number of keys is %zu in %zu ranges", params.num_keys(), params.ranges.size());
+    return (unsigned long) params.num_keys();
 }
 
 template<typename IO>
@@ -295,6 +456,7 @@ unsigned long KVOrderedFDB<IO>::get_raw_capacity() const {
 
 template<typename IO>
 void KVOrderedFDB<IO>::thread_local_entry() {
+    tx_pool.reuse = conf->tx_reuse;
     generic_futures = (FDBFuture **) malloc(1024 * sizeof(FDBFuture * *));
     if (generic_futures == nullptr) {
         FATAL("Could not allocate generic futures");
@@ -312,7 +474,16 @@ KVOrderedFDB<IO>::get_range(const char start_key[], size_t start_key_size, const
                             size_t end_key_size,
                             char *kv_buff, size_t kv_buff_size, size_t &kv_size_read,
                             std::vector<char *> &kv_ptrs) {
-    NOT_IMPLEMENTED
+    op_params_get_range params = op_params_get_range(start_key, start_key_size, end_key, end_key_size,
+                                                     (int) conf->scan_row_limit, (int) conf->scan_byte_limit,
+                                                     scan_mode, conf->scan_snapshot ? SNAPSHOT_READ : SERIALIZABLE_READ,
+                                                     kv_buff, kv_buff_size, kv_ptrs);
+    fdb_op_get_range op = fdb_op_get_range(&params);
+    int rc = run_fdb_op(&op, db);
+    kv_size_read = params.size_read;
+    zrl_fkvb_scan_rows = params.rows;
+    zrl_fkvb_scan_bytes = params.bytes;
+    return rc;
 }
 
 
@@ -361,42 +532,45 @@ On receiving any type of error from an fdb_transaction_*() function, the applica
 #endif
 
 int run_fdb_op(fdb_op_g *op, FDBDatabase *db) {
-    FDBTransaction *tr = NULL;
-    fdb_error_t e = fdb_database_create_transaction(db, &tr);
-    checkError(e, "create transaction");
+    const u64 alloc_init = ticks::get_ticks();
+    FDBTransaction *tr = tx_pool.get(db);
+    const u64 alloc_latency = ticks::get_ticks() - alloc_init;
+    fdb_error_t e;
     //const uint8_t limit = 5;
     /*if (fdb_transaction_set_option(tr, FDB_TR_OPTION_RETRY_LIMIT, (const uint8_t *) &limit, sizeof(uint64_t))) {
         FATAL("COULD NOT SET RETRY LIMIT TO TX");
     }*/
 
     LOG_OP(tr);
+    bool fresh_grv = false; //Set when the cluster rejected the read version of the previous attempt
 
 //NB: In case of failure, grv and commit time are taken only for the successful run
     while (1) {
+        zrl_fkvb_retries.attempts++;
 #ifdef GRV
         //take time
         fdb_error_t grv_e = 0;
         uint64_t init, end;
+        int64_t grv;
         init = ticks::get_ticks();
-	//TODO, FIXME:  if we get a tx_too_old error, we should reset the grv no matter what the cache says
-	//cache_grv has been translated to ticks
-	//it is 0 if disabled
-	bool get_grv=(init-last_grv_wallclock)>grv_cache_tics_ms; 
-	if(get_grv){
+	//grv_cache_tics_ms is 0 if caching is disabled
+	if (!fresh_grv && cached_grv(&local_grv, init, grv)) {
+		//Use the last grv
+		fdb_transaction_set_read_version(tr, grv);
+	} else {
 		//Get a grv from FDB and extract the value
 		do {
 		    FDBFuture *grv_f = fdb_transaction_get_read_version(tr);
 		    grv_e = fdb_future_block_until_ready(grv_f);
 		    //get the grv. This is done in any case
-		    if(fdb_future_get_int64(grv_f, &last_grv))FATAL("Getting grv value out of future gave error\n");
+		    if(fdb_future_get_int64(grv_f, &grv))FATAL("Getting grv value out of future gave error\n");
 		    fdb_future_destroy(grv_f);
+		    zrl_fkvb_grv_requests++;
 		} while (grv_e);
-	}else{
-		//Use the last grv
-		fdb_transaction_set_read_version(tr,last_grv);
+		cache_grv(&local_grv, init, grv);
+		fresh_grv = false;
 	}
 	end = ticks::get_ticks();
-	if(get_grv)last_grv_wallclock = end;
         zrl_fkvb_begin_latency =end-init; //In case of retries, we consider the init time as the sum of all attempts
 #endif
         struct op_result result = op->run(tr);
@@ -422,9 +596,18 @@ int run_fdb_op(fdb_op_g *op, FDBDatabase *db) {
          * because state used by fdb_transaction_on_error() to implement its backoff strategy and state related to timeouts and retry limits is stored there.
          */
         if (e) {//Error in the operation OR error in the commit
+            if (stale_grv_error(e)) {
+                //Whatever the cache says, the retry (and the next transactions) need a new read version
+                invalidate_grv(&local_grv);
+                fresh_grv = true;
+                zrl_fkvb_grv_stale++;
+            }
+            count_error(zrl_fkvb_retries, e);
+            const u64 backoff_init = ticks::get_ticks();
             FDBFuture *f = fdb_transaction_on_error(tr, e);
             fdb_error_t retryE = waitError(f);
             fdb_future_destroy(f);
+            zrl_fkvb_retries.backoff_latency += ticks::get_ticks() - backoff_init;
             if (retryE) {
                 fdb_transaction_destroy(tr);
 #if 0
@@ -450,13 +633,183 @@ int run_fdb_op(fdb_op_g *op, FDBDatabase *db) {
                 TRACE_FORMAT("WARNING: Retrying op %s", op->str());
             }
         } else {//No FDB errors, but check for app-level errors
-            fdb_transaction_destroy(tr);
+            const u64 release_init = ticks::get_ticks();
+            tx_pool.put(tr);
+            zrl_fkvb_tx_alloc_latency = alloc_latency + ticks::get_ticks() - release_init;
             return result.rc;
         }
     }
 
 }
 
+/*
+ * Asynchronous counterpart of run_fdb_op for generic transactions. Instead of blocking on each future, every step
+ * registers a callback that runs the next one: GRV -> reads -> commit, and on_error -> GRV upon a retriable error.
+ * Callbacks are run by the network thread (or right away by the calling thread, if the future is already ready),
+ * so no step blocks.
+ */
+static void async_on_grv(FDBFuture *f, void *p);
+
+static void async_on_read(FDBFuture *f, void *p);
+
+static void async_on_commit(FDBFuture *f, void *p);
+
+static void async_on_retry(FDBFuture *f, void *p);
+
+static void async_on_error(fdb_async_generic *tx, fdb_error_t e) {
+    TRACE_FORMAT("WARNING: Retrying op %s (%s)", "generic_op_async", fdb_get_error(e));
+    if (stale_grv_error(e)) {
+        invalidate_grv(tx->grv_cache);
+        tx->fresh_grv = true;
+        tx->grv_cache->stale.fetch_add(1, std::memory_order_relaxed);
+    }
+    count_error(tx->retries, e);
+    tx->backoff_init = ticks::get_ticks();
+    FDBFuture *f = fdb_transaction_on_error(tx->tr, e);
+    checkError(fdb_future_set_callback(f, async_on_retry, tx), "set callback");
+}
+
+static void async_finish(fdb_async_generic *tx) {
+    tx->pool->put(tx->tr);
+    tx->cb(tx->ctx, tx->rc, tx->begin_latency, tx->commit_latency, tx->retries);
+    delete tx;
+}
+
+static void async_commit(fdb_async_generic *tx) {
+    tx->init = ticks::get_ticks();
+    if (tx->is_ro()) {//Do not commit generic
+        tx->commit_latency = ticks::get_ticks() - tx->init;
+        async_finish(tx);
+        return;
+    }
+    FDBFuture *f = fdb_transaction_commit(tx->tr);
+    checkError(fdb_future_set_callback(f, async_on_commit, tx), "set callback");
+}
+
+static void async_reads_done(fdb_async_generic *tx) {
+    fdb_error_t first_e = 0;
+    int done;
+    char *key_ptr = tx->keys;
+    for (done = 0; done < tx->num_op; done++) {
+        if (!tx->rw[done]) {
+            FDBFuture *f = tx->futures[done];
+            fdb_bool_t present;
+            uint8_t const *outValue;
+            int outValueLength;
+            fdb_error_t e = fdb_future_get_value(f, &present, &outValue, &outValueLength);
+            fdb_future_destroy(f);
+            if (e) {
+                if (!first_e) first_e = e;
+            } else if (!present && !tx->missing_ok) {
+                PRINT_FORMAT("WARNING: Value not found for key %.*s", (int) tx->key_sizes[done], key_ptr);
+                tx->rc = 2;
+            }
+        }
+        key_ptr += tx->key_sizes[done];
+    }
+    if (first_e) {
+        async_on_error(tx, first_e);
+    } else {
+        async_commit(tx);
+    }
+}
+
+static void async_issue(fdb_async_generic *tx) {
+    int done, reads = 0, put_index = 0;
+    char *key_ptr = tx->keys;
+    tx->rc = 0;
+    for (done = 0; done < tx->num_op; done++) {
+        if (tx->bulk) {
+            fdb_bulk_set(tx->tr, key_ptr, tx->key_sizes[done], tx->put_values[done], tx->put_value_sizes[done]);
+        } else if (tx->rw[done]) {
+            fdb_generic_set(tx->tr, key_ptr, tx->key_sizes[done], tx->put_values[put_index],
+                            tx->put_value_sizes[put_index], tx->flags ? tx->flags[done] : 0, tx->atomic_op);
+            put_index++;
+        } else {
+            tx->futures[done] = fdb_generic_get(tx->tr, key_ptr, tx->key_sizes[done],
+                                                tx->flags ? tx->flags[done] : 0);
+            reads++;
+        }
+        key_ptr += tx->key_sizes[done];
+    }
+    if (!reads) {
+        async_commit(tx);
+        return;
+    }
+    //One extra reference, so that the reads cannot complete the transaction while we are registering the callbacks
+    tx->pending_reads = reads + 1;
+    for (done = 0; done < tx->num_op; done++) {
+        if (!tx->rw[done]) {
+            checkError(fdb_future_set_callback(tx->futures[done], async_on_read, tx), "set callback");
+        }
+    }
+    if (--tx->pending_reads == 0) {
+        async_reads_done(tx);
+    }
+}
+
+void run_fdb_op_async(fdb_async_generic *tx) {
+    tx->init = ticks::get_ticks();
+    tx->retries.attempts++;
+    int64_t grv;
+    //Same GRV caching policy as run_fdb_op
+    if (tx->fresh_grv || !cached_grv(tx->grv_cache, tx->init, grv)) {
+        tx->fresh_grv = false;
+        tx->grv_cache->requests.fetch_add(1, std::memory_order_relaxed);
+        FDBFuture *f = fdb_transaction_get_read_version(tx->tr);
+        checkError(fdb_future_set_callback(f, async_on_grv, tx), "set callback");
+    } else {
+        fdb_transaction_set_read_version(tx->tr, grv);
+        tx->begin_latency = ticks::get_ticks() - tx->init;
+        async_issue(tx);
+    }
+}
+
+static void async_on_grv(FDBFuture *f, void *p) {
+    fdb_async_generic *tx = (fdb_async_generic *) p;
+    int64_t grv;
+    fdb_error_t e = fdb_future_get_int64(f, &grv);
+    fdb_future_destroy(f);
+    if (e) {
+        async_on_error(tx, e);
+        return;
+    }
+    cache_grv(tx->grv_cache, tx->init, grv);
+    tx->begin_latency = ticks::get_ticks() - tx->init;
+    async_issue(tx);
+}
+
+static void async_on_read(FDBFuture *f, void *p) {
+    fdb_async_generic *tx = (fdb_async_generic *) p;
+    if (--tx->pending_reads == 0) {
+        async_reads_done(tx);
+    }
+}
+
+static void async_on_commit(FDBFuture *f, void *p) {
+    fdb_async_generic *tx = (fdb_async_generic *) p;
+    fdb_error_t e = fdb_future_get_error(f);
+    fdb_future_destroy(f);
+    if (e) {
+        async_on_error(tx, e);
+        return;
+    }
+    tx->commit_latency = ticks::get_ticks() - tx->init;
+    async_finish(tx);
+}
+
+static void async_on_retry(FDBFuture *f, void *p) {
+    fdb_async_generic *tx = (fdb_async_generic *) p;
+    fdb_error_t e = fdb_future_get_error(f);
+    fdb_future_destroy(f);
+    if (e) {
+        fdb_transaction_destroy(tx->tr);
+        FATAL("A non-retriable error occurred on op %s", "generic_op_async");
+    }
+    tx->retries.backoff_latency += ticks::get_ticks() - tx->backoff_init;
+    run_fdb_op_async(tx);
+}
+
 //Template instantiation. This goes in the cc file
 template
 class KVOrderedFDB<int>;
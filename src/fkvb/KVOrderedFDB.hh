@@ -31,8 +31,12 @@ template<typename IO>
 class KVOrderedFDB : public KVOrdered<IO> {
 private:
     pthread_t _netThread;
+    pthread_t _grvThread;
     FDBDatabase *db;
     fkvb_test_conf *conf;
+    FDBStreamingMode scan_mode;
+    FDBMutationType atomic_op; //Of the atomic ops of generic transactions
+    bool missing_ok; //Reads of missing keys do not fail, as they can have been deleted by the workload
 
 public:
     KVOrderedFDB(fkvb_test_conf *conf);
@@ -48,14 +52,25 @@ public:
 
     int del(const char key[], size_t key_size);
 
-    int put_bulk(size_t numkv, char *k_ptr, size_t *k_sizes, char *v_ptrs, size_t *v_sizes);
+    int clear_range(const char start_key[], size_t start_key_size, size_t max_keys, std::string &deleted_keys,
+                    std::vector<size_t> &deleted_key_sizes);
 
-    int generic(int num_op, bool *rw, char *keys, size_t *key_sizes, char **put_values,
-                size_t *put_value_sizes, char *get_buffer, size_t get_buffer_size, size_t *read_values,
+    int put_bulk(size_t numkv, char *k_ptr, size_t *k_sizes, char **v_ptrs, size_t *v_sizes);
+
+    int put_bulk_async(size_t numkv, char *k_ptr, size_t *k_sizes, char **v_ptrs, size_t *v_sizes, kv_async_cb cb,
+                       void *ctx);
+
+    int generic(int num_op, bool *rw, uint8_t *flags, char *keys, size_t *key_sizes, char **put_values,
+                size_t *put_value_sizes, std::vector<char> &get_buffer, size_t *read_values,
                 std::vector<char *> &read_values_ptr);
 
+    int generic_async(int num_op, bool *rw, uint8_t *flags, char *keys, size_t *key_sizes, char **put_values,
+                      size_t *put_value_sizes, kv_async_cb cb, void *ctx);
+
     unsigned long get_size() const;
 
+    unsigned long count_keys(const std::vector<std::string> &boundaries) const;
+
     unsigned long get_raw_capacity() const;
 
     void thread_local_entry();
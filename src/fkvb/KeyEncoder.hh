@@ -0,0 +1,203 @@
+/*
+ *  Copyright (c) 2021 International Business Machines
+ *  All rights reserved.
+ *
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Authors: Diego Didona (ddi@zurich.ibm.com),
+ *
+ */
+
+#ifndef KEYENCODER_HH
+#define KEYENCODER_HH
+
+#include "rnd/fkvb_rnd.hh"
+#include "defs.hh"
+#include <string>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include <cassert>
+
+#define PREFIX "U: "
+#define KEY_LENGTH_SAMPLES (1 << 16)
+#define KEY_LENGTH_SEED 5215066532470317089ULL
+
+/*
+ * Length of the key of every index, drawn from the --key_size distribution. The pattern is sampled once, with a fixed
+ * seed, into a table of KEY_LENGTH_SAMPLES lengths, and the length of key k is the entry at a hash of k: it only
+ * depends on k and on the distribution, so the population and the test (and all the processes) agree on every key.
+ * min_size and max_size are the bounds of the table, i.e., of all the keys
+ */
+struct key_lengths {
+    size_t min_size, max_size;
+    std::vector<u16> table;
+
+    //Takes ownership of the pattern
+    explicit key_lengths(io_pattern *pattern) : min_size(~0UL), max_size(0), table(KEY_LENGTH_SAMPLES) {
+        for (u16 &len: table) {
+            const size_t l = pattern->next();
+            if (l == 0 || l > 0xFFFF) {
+                FATAL("Key size %zu out of range", l);
+            }
+            len = (u16) l;
+            min_size = std::min(min_size, l);
+            max_size = std::max(max_size, l);
+        }
+        delete pattern;
+    }
+
+    inline size_t of(const int key) const {
+        return table[splitmix64(KEY_LENGTH_SEED + (u64) (u32) key) & (KEY_LENGTH_SAMPLES - 1)];
+    }
+};
+
+/*
+ * Key encoders build the key of a given key index. FKVB takes the encoder as a template parameter, chosen from
+ * --key_type by the factory, so that building a key is not a virtual call and is inlined in the ops.
+ *
+ * Every encoder keeps the image of its keys (of the largest size) with the prefix (and the padding) already in place:
+ * building a key is a copy of the image, and then the encoding of the index in the suffix.
+ */
+struct key_encoder {
+    const key_lengths &lengths;
+    const size_t prefix_len;
+    const size_t fixed_size; //0 if keys have different sizes
+    std::string image; //Prefix followed by the padding of the suffix
+
+    key_encoder(const key_lengths &_lengths, const std::string &prefix, char padding) :
+            lengths(_lengths), prefix_len(prefix.length()),
+            fixed_size(lengths.min_size == lengths.max_size ? lengths.max_size : 0) {
+        if (lengths.min_size <= prefix_len) {
+            FATAL("Key size %zu must be larger than the prefix (%zu bytes)", lengths.min_size, prefix_len);
+        }
+        image = prefix + std::string(lengths.max_size - prefix_len, padding);
+    }
+
+    //The size is kept in the encoder for fixed-size keys, which saves the table lookup
+    inline size_t size_of(const int key) const {
+        return fixed_size ? fixed_size : lengths.of(key);
+    }
+
+    static size_t digits(size_t x) {
+        size_t d = 1;
+        while (x >= 10) {
+            x /= 10;
+            d++;
+        }
+        return d;
+    }
+};
+
+//Two ASCII digits for every number in [0, 100), so that itoa takes one division every two digits
+static const char key_digit_pairs[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839404142434445464748495051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+
+/*
+ * Key types fkvb and sharded_fkvb: the prefix ("U: " or the 8-byte shard of the thread), and the key index in decimal,
+ * zero-padded to the smallest key size. Longer keys are padded with zeroes after the index, so keys are sorted as their
+ * indexes whatever their sizes
+ */
+struct decimal_key_encoder : key_encoder {
+
+    decimal_key_encoder(const key_lengths &_lengths, const std::string &prefix, size_t num_keys) :
+            key_encoder(_lengths, prefix, '0') {
+        if (lengths.min_size - prefix_len < digits(num_keys)) {
+            FATAL("Cannot support %zu keys with a min key size of %zu given a prefix of %zu bytes", num_keys,
+                  lengths.min_size, prefix_len);
+        }
+    }
+
+    //shard is nullptr for unsharded keys
+    static decimal_key_encoder *create(const key_lengths &lengths, size_t num_keys, const std::string *shard) {
+        return new decimal_key_encoder(lengths, shard ? *shard : std::string(PREFIX), num_keys);
+    }
+
+    inline void build(const int key, char *out_buf, size_t *out_size) {
+        u32 k = (u32) key;
+        const size_t key_size = size_of(key);
+        char *ptr = out_buf + lengths.min_size;
+        memcpy(out_buf, image.data(), key_size);
+        //Digits are written from the last one. The zeroes before the first digit come from the image
+        while (k >= 100) {
+            const u32 pair = (k % 100) * 2;
+            k /= 100;
+            ptr -= 2;
+            memcpy(ptr, &key_digit_pairs[pair], 2);
+        }
+        if (k >= 10) {
+            ptr -= 2;
+            memcpy(ptr, &key_digit_pairs[k * 2], 2);
+        } else {
+            *(--ptr) = (char) ('0' + k);
+        }
+        *out_size = key_size;
+        TRACE_FORMAT("Next key %.*s", (int) key_size, out_buf);
+    }
+};
+
+/*
+ * Key types random and sharded_random: the prefix (none, or the 8-byte shard of the thread), and random chars that
+ * only depend on the key index, so that the same index always gives the same key.
+ * Chars are alphanumeric-ish ([48, 110)) for random keys, and in [0, 250) for sharded ones.
+ * No guarantees there's not going to be any overlap
+ */
+#define KEY_RND_SEED 1118388721419649241ULL
+
+struct random_key_encoder : key_encoder {
+    const u32 char_beg, char_range;
+
+    random_key_encoder(const key_lengths &_lengths, const std::string &prefix, u32 beg, u32 end) :
+            key_encoder(_lengths, prefix, '\0'), char_beg(beg), char_range(end - beg) {
+        assert(end > beg && char_range <= 256);
+    }
+
+    static random_key_encoder *create(const key_lengths &lengths, size_t num_keys, const std::string *shard) {
+        if (shard) {
+            return new random_key_encoder(lengths, *shard, 0, 250);
+        }
+        return new random_key_encoder(lengths, std::string(), 48, 48 + 26 + 26 + 10);
+    }
+
+    /*
+     * Maps the 8 random bytes of a word to 8 chars at once: every byte becomes beg + (byte * range) >> 8, so every char
+     * of the range comes from 256 / range byte values, rounded down or up. The bytes are multiplied in 16-bit lanes,
+     * even and odd ones apart, so that no product overflows into the next byte
+     */
+    static inline u64 to_chars(u64 word, u64 range, u64 beg) {
+        const u64 low = 0x00FF00FF00FF00FFULL;
+        const u64 even = ((word & low) * range >> 8) & low;
+        const u64 odd = ((word >> 8) & low) * range & ~low;
+        return (even | odd) + beg * 0x0101010101010101ULL;
+    }
+
+    /*
+     * The chars come 8 at a time from a counter-based generator: word w of the key is splitmix64 of the hash of the
+     * key index plus w. There is no generator to reseed, and no per-byte floating point ops
+     */
+    inline void build(const int key, char *out_buf, size_t *out_size) {
+        const size_t key_size = size_of(key);
+        char *ptr = out_buf + prefix_len;
+        size_t left = key_size - prefix_len;
+        const u64 range = char_range, beg = char_beg;
+        u64 counter = splitmix64(KEY_RND_SEED + (u64) (u32) key);
+        u64 chars;
+        memcpy(out_buf, image.data(), prefix_len);
+        while (left >= sizeof(chars)) {
+            counter += SPLITMIX64_GAMMA;
+            chars = to_chars(splitmix64(counter), range, beg);
+            memcpy(ptr, &chars, sizeof(chars));
+            ptr += sizeof(chars);
+            left -= sizeof(chars);
+        }
+        if (left) {
+            counter += SPLITMIX64_GAMMA;
+            chars = to_chars(splitmix64(counter), range, beg);
+            memcpy(ptr, &chars, left);
+        }
+        *out_size = key_size;
+        TRACE_FORMAT("Next key %.*s", (int) key_size, out_buf);
+    }
+};
+
+#endif //KEYENCODER_HH
@@ -0,0 +1,89 @@
+/*
+ *  Copyright (c) 2021 International Business Machines
+ *  All rights reserved.
+ *
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Authors: Diego Didona (ddi@zurich.ibm.com),
+ *
+ */
+
+#ifndef VALUEPOOL_HH
+#define VALUEPOOL_HH
+
+#include "rnd/fkvb_rnd.hh"
+#include "defs.hh"
+#include <string.h>
+#include <sys/mman.h>
+
+#define VALUE_POOL_SIZE (32UL << 20)
+#define VALUE_POOL_PIECE 128 //Bytes that get the same compression ratio
+#define VALUE_POOL_SEED 7640891576956012809ULL
+
+/*
+ * The bytes that values are taken from. There is one pool per process, shared by all threads: it is allocated and
+ * filled once (on hugepages if any are reserved, otherwise on transparent hugepages if enabled), and then made
+ * read-only, so values can be passed to the KV without copies.
+ *
+ * The compressibility of the bytes is set by the compression ratio (compressed size / size, in (0, 1]): every piece
+ * of VALUE_POOL_PIECE bytes starts with ratio * VALUE_POOL_PIECE random bytes, that are then repeated to the end of the
+ * piece. 1 gives incompressible bytes, and smaller ratios give the repetitions that LZ-style compressors remove.
+ */
+struct value_pool {
+    const char *data;
+    const size_t size;
+    const double compression_ratio;
+    bool hugetlb; //On reserved hugepages, rather than on transparent ones
+
+    //The first call allocates the pool, so the ratio of later calls is ignored
+    static const value_pool &shared(double compression_ratio) {
+        static const value_pool pool(compression_ratio);
+        return pool;
+    }
+
+private:
+
+    explicit value_pool(double ratio) : data(nullptr), size(VALUE_POOL_SIZE), compression_ratio(ratio),
+                                        hugetlb(true) {
+        void *mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (mem == MAP_FAILED) {
+            hugetlb = false;
+            mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (mem == MAP_FAILED) {
+                FATAL("Could not allocate the value pool of %zu bytes", size);
+            }
+            madvise(mem, size, MADV_HUGEPAGE); //Best effort
+        }
+        fill((char *) mem);
+        if (mprotect(mem, size, PROT_READ)) {
+            ERROR("Could not make the value pool read-only");
+        }
+        data = (const char *) mem;
+        PRINT_FORMAT("Value pool: %zu MB on %s hugepages, compression ratio %.2f", size >> 20,
+                     hugetlb ? "reserved" : "transparent", compression_ratio);
+    }
+
+    void fill(char *buf) const {
+        size_t raw = (size_t) (compression_ratio * VALUE_POOL_PIECE + 0.5);
+        u64 counter = VALUE_POOL_SEED;
+        if (raw < 1) {
+            raw = 1;
+        } else if (raw > VALUE_POOL_PIECE) {
+            raw = VALUE_POOL_PIECE;
+        }
+        for (size_t piece = 0; piece < size; piece += VALUE_POOL_PIECE) {
+            char *p = buf + piece;
+            size_t i;
+            for (i = 0; i < raw; i += sizeof(u64)) {
+                counter += SPLITMIX64_GAMMA;
+                const u64 word = splitmix64(counter);
+                memcpy(p + i, &word, raw - i < sizeof(u64) ? raw - i : sizeof(u64));
+            }
+            for (i = raw; i < VALUE_POOL_PIECE; i++) {
+                p[i] = p[i - raw];
+            }
+        }
+    }
+};
+
+#endif //VALUEPOOL_HH
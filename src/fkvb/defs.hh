@@ -62,7 +62,8 @@
 
 enum OPS {
     OP_READ = 1, OP_UPDATE = 2, OP_INSERT = 3, OP_SCAN = 4, OP_RMW = 5, OP_GENERIC = 6,
-    OP_INIT = 7, OP_COMMIT = 8, OP_LAST = 9
+    OP_INIT = 7, OP_COMMIT = 8, OP_TX_ALLOC = 9, OP_ATOMIC = 10, OP_DELETE = 11,
+    OP_CLEAR_RANGE = 12, OP_LAST = 13
 };
 
 
@@ -0,0 +1,831 @@
+/*
+ *  Copyright (c) 2021 International Business Machines
+ *  All rights reserved.
+ *
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Authors: Diego Didona (ddi@zurich.ibm.com),
+ *
+ */
+
+/*
+ * In-process, in-memory implementation of the subset of fdb_c.h used by fkvb.
+ * It is meant to measure the overhead of the harness (key building, statistics, run_fdb_op bookkeeping) without
+ * a cluster, and to profile the whole FDB code path of fkvb on a laptop. It is NOT a database:
+ *  - all the data lives in one std::map protected by a single lock;
+ *  - versions advance at 1M versions per second like in FDB, so read versions older than 5 seconds
+ *    fail with transaction_too_old (1007) and read versions from the future fail with future_version (1009);
+ *  - serializable reads (single keys and ranges) and read conflict ranges are checked at commit time against the
+ *    last write version of every key, and fail with not_committed (1020) like in FDB. Writes to a range only
+ *    conflict on the keys that exist when the transaction commits;
+ *  - reads see the writes of their own transaction only for single-key gets.
+ *
+ * Futures are completed by the thread that runs fdb_run_network after an artificial latency that can be set
+ * with the knob fake_latency_us (e.g., --additional_args fake_latency_us=500). With 0 latency (the default),
+ * futures are completed inline, on the thread that creates them.
+ *
+ * Built as lib/fdb/fake/libfdb_c.so by make FAKE_FDB=1.
+ */
+
+#define FDB_API_VERSION 620
+
+#include "620/fdb_c.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <queue>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+
+#define FAKE_CLIENT_VERSION "6.2.0-fkvb-fake"
+#define FAKE_MVCC_WINDOW 5000000 //Versions (5 sec) after which a read version is too old
+
+#define ERR_TX_TOO_OLD 1007
+#define ERR_FUTURE_VERSION 1009
+#define ERR_NOT_COMMITTED 1020
+#define ERR_CANCELLED 1101
+#define ERR_INVALID_OPTION 2007
+#define ERR_API_VERSION 2203
+
+struct FDB_database {
+};
+
+struct mutation {
+    FDBMutationType type; //We use SET_VALUE (0) for sets, -1 for clears and -2 for clear ranges
+    std::string key, param;
+};
+
+#define MUTATION_SET ((FDBMutationType) 0)
+#define MUTATION_CLEAR ((FDBMutationType) -1)
+#define MUTATION_CLEAR_RANGE ((FDBMutationType) -2)
+
+struct FDB_transaction {
+    int64_t read_version = 0;
+    std::vector<mutation> mutations;
+    std::map<std::string, std::string> writes; //Own sets, for RYW on single gets. Cleared keys are not in the map
+    std::set<std::string> cleared;
+    std::set<std::string> read_keys;
+    std::vector<std::pair<std::string, std::string>> read_ranges, write_ranges;
+    bool next_write_no_conflict = false;
+    int64_t committed_version = -1;
+    int retries = 0;
+
+    void reset() {
+        read_version = 0;
+        mutations.clear();
+        writes.clear();
+        cleared.clear();
+        read_keys.clear();
+        read_ranges.clear();
+        write_ranges.clear();
+        next_write_no_conflict = false;
+        committed_version = -1;
+    }
+};
+
+struct FDB_future {
+    std::mutex m;
+    std::condition_variable cv;
+    std::atomic<int> refs;
+    bool ready = false;
+    fdb_error_t err = 0;
+    FDBCallback cb = nullptr;
+    void *cb_param = nullptr;
+    //Executed upon completion, before the future is set ready
+    std::function<fdb_error_t(FDB_future *)> work;
+
+    int64_t i64 = 0;
+    fdb_bool_t present = 0;
+    std::string value, key;
+    std::vector<std::pair<std::string, std::string>> kvs;
+    std::vector<FDBKeyValue> kv_view;
+    fdb_bool_t more = 0;
+
+    FDB_future() : refs(1) {}
+};
+
+namespace {
+
+std::mutex store_lock;
+std::map<std::string, std::string> store;
+std::map<std::string, int64_t> write_versions; //Last version that wrote a key (or a write conflict range on it)
+int64_t last_commit_version = 0;
+
+std::atomic<uint64_t> latency_us(0);
+const auto boot = std::chrono::steady_clock::now();
+
+/*
+ * State of the network thread. It is never destroyed: fkvb does not stop the network, so the network thread may still
+ * be waiting on net_cv when the process exits, and destroying a condition variable with a waiter blocks forever
+ */
+std::mutex &net_lock = *new std::mutex;
+std::condition_variable &net_cv = *new std::condition_variable;
+bool net_stopped = false;
+typedef std::pair<std::chrono::steady_clock::time_point, FDB_future *> timed_future;
+struct later {
+    bool operator()(const timed_future &a, const timed_future &b) const { return a.first > b.first; }
+};
+std::priority_queue<timed_future, std::vector<timed_future>, later> &pending =
+        *new std::priority_queue<timed_future, std::vector<timed_future>, later>;
+
+int64_t current_version() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now() - boot).count() + 1;
+}
+
+void unref(FDB_future *f) {
+    if (--f->refs == 0) {
+        delete f;
+    }
+}
+
+void complete(FDB_future *f) {
+    fdb_error_t e = f->work ? f->work(f) : 0;
+    FDBCallback cb;
+    void *param;
+    {
+        std::lock_guard<std::mutex> l(f->m);
+        f->err = e;
+        f->ready = true;
+        cb = f->cb;
+        param = f->cb_param;
+    }
+    f->cv.notify_all();
+    if (cb) {
+        cb(f, param);
+    }
+}
+
+FDB_future *schedule(std::function<fdb_error_t(FDB_future *)> work) {
+    FDB_future *f = new FDB_future();
+    f->work = std::move(work);
+    const uint64_t lat = latency_us.load(std::memory_order_relaxed);
+    if (!lat) {
+        complete(f);
+        return f;
+    }
+    f->refs++; //Reference held by the network thread
+    {
+        std::lock_guard<std::mutex> l(net_lock);
+        pending.push(timed_future(std::chrono::steady_clock::now() + std::chrono::microseconds(lat), f));
+    }
+    net_cv.notify_one();
+    return f;
+}
+
+FDB_future *ready_error(fdb_error_t e) {
+    return schedule([e](FDB_future *) { return e; });
+}
+
+//Assigns the read version lazily, like FDB does on the first read of a transaction without GRV
+fdb_error_t check_read_version(FDBTransaction *tr) {
+    const int64_t now = current_version();
+    if (!tr->read_version) {
+        tr->read_version = now;
+    }
+    if (tr->read_version > now) {
+        return ERR_FUTURE_VERSION;
+    }
+    if (now - tr->read_version > FAKE_MVCC_WINDOW) {
+        return ERR_TX_TOO_OLD;
+    }
+    return 0;
+}
+
+/*
+ * Resolves a key selector to an iterator in the store.
+ * The base key is the last key < k (or <= k if or_equal); the selected key is the one offset positions after it
+ */
+std::map<std::string, std::string>::iterator resolve(const std::string &k, fdb_bool_t or_equal, int offset,
+                                                      bool *before_begin) {
+    auto it = or_equal ? store.upper_bound(k) : store.lower_bound(k);
+    *before_begin = false;
+    //it is the key at offset 1
+    for (; offset > 1 && it != store.end(); offset--) {
+        ++it;
+    }
+    for (; offset < 1; offset++) {
+        if (it == store.begin()) {
+            *before_begin = true;
+            break;
+        }
+        --it;
+    }
+    return it;
+}
+
+bool key_before(const std::map<std::string, std::string>::iterator &a,
+                const std::map<std::string, std::string>::iterator &b) {
+    if (a == store.end()) return false;
+    if (b == store.end()) return true;
+    return a->first < b->first;
+}
+
+int mode_bytes(FDBStreamingMode mode, int iteration) {
+    switch (mode) {
+        case FDB_STREAMING_MODE_SMALL:
+            return 256;
+        case FDB_STREAMING_MODE_MEDIUM:
+            return 1000;
+        case FDB_STREAMING_MODE_LARGE:
+            return 4096;
+        case FDB_STREAMING_MODE_SERIAL:
+            return 80000;
+        case FDB_STREAMING_MODE_ITERATOR: {
+            const int it = iteration < 1 ? 1 : (iteration > 6 ? 6 : iteration);
+            return 4096 << (it - 1);
+        }
+        case FDB_STREAMING_MODE_WANT_ALL:
+        case FDB_STREAMING_MODE_EXACT:
+        default:
+            return 0;
+    }
+}
+
+void apply_atomic(std::string &cur, bool exists, const std::string &param, FDBMutationType type) {
+    if (!exists) {
+        cur.assign(param.size(), '\0');
+    }
+    switch (type) {
+        case FDB_MUTATION_TYPE_ADD: {
+            //Little-endian addition, truncated to the size of the operand
+            cur.resize(param.size(), '\0');
+            unsigned carry = 0;
+            for (size_t i = 0; i < param.size(); i++) {
+                unsigned s = (unsigned char) cur[i] + (unsigned char) param[i] + carry;
+                cur[i] = (char) (s & 0xFF);
+                carry = s >> 8;
+            }
+            break;
+        }
+        case FDB_MUTATION_TYPE_BIT_AND:
+        case FDB_MUTATION_TYPE_BIT_OR:
+        case FDB_MUTATION_TYPE_BIT_XOR: {
+            cur.resize(param.size(), '\0');
+            for (size_t i = 0; i < param.size(); i++) {
+                if (type == FDB_MUTATION_TYPE_BIT_AND) cur[i] &= param[i];
+                else if (type == FDB_MUTATION_TYPE_BIT_OR) cur[i] |= param[i];
+                else cur[i] ^= param[i];
+            }
+            break;
+        }
+        case FDB_MUTATION_TYPE_MAX:
+        case FDB_MUTATION_TYPE_MIN: {
+            cur.resize(param.size(), '\0');
+            //Little-endian unsigned comparison, starting from the most significant byte
+            int cmp = 0;
+            for (size_t i = param.size(); i-- > 0 && !cmp;) {
+                cmp = (int) (unsigned char) param[i] - (int) (unsigned char) cur[i];
+            }
+            if (!exists || (type == FDB_MUTATION_TYPE_MAX ? cmp > 0 : cmp < 0)) {
+                cur = param;
+            }
+            break;
+        }
+        case FDB_MUTATION_TYPE_BYTE_MIN:
+            if (!exists || param < cur) cur = param;
+            break;
+        case FDB_MUTATION_TYPE_BYTE_MAX:
+            if (!exists || param > cur) cur = param;
+            break;
+        case FDB_MUTATION_TYPE_APPEND_IF_FITS:
+            if (exists && cur.size() + param.size() <= 100000) cur += param;
+            else if (!exists) cur = param;
+            break;
+        default:
+            cur = param;
+    }
+}
+
+fdb_error_t commit_locked(FDBTransaction *tr, int64_t *version) {
+    //Read-only transactions do not go through the resolvers
+    if (tr->mutations.empty() && tr->write_ranges.empty()) {
+        *version = -1;
+        return 0;
+    }
+    const int64_t now = current_version();
+    const int64_t rv = tr->read_version ? tr->read_version : now;
+    if (now - rv > FAKE_MVCC_WINDOW) {
+        return ERR_TX_TOO_OLD;
+    }
+    for (const std::string &k : tr->read_keys) {
+        auto w = write_versions.find(k);
+        if (w != write_versions.end() && w->second > rv) {
+            return ERR_NOT_COMMITTED;
+        }
+    }
+    for (const auto &r : tr->read_ranges) {
+        for (auto w = write_versions.lower_bound(r.first); w != write_versions.end() && w->first < r.second; ++w) {
+            if (w->second > rv) {
+                return ERR_NOT_COMMITTED;
+            }
+        }
+    }
+    const int64_t v = now > last_commit_version ? now : last_commit_version + 1;
+    //Range writes (e.g., clear ranges) are marked before they remove their keys
+    for (const auto &r : tr->write_ranges) {
+        if (!r.second.empty()) {
+            for (auto w = store.lower_bound(r.first); w != store.end() && w->first < r.second; ++w) {
+                write_versions[w->first] = v;
+            }
+        }
+    }
+    for (const mutation &m : tr->mutations) {
+        if (m.type == MUTATION_SET) {
+            store[m.key] = m.param;
+        } else if (m.type == MUTATION_CLEAR) {
+            store.erase(m.key);
+        } else if (m.type == MUTATION_CLEAR_RANGE) {
+            store.erase(store.lower_bound(m.key), store.lower_bound(m.param));
+        } else {
+            auto it = store.find(m.key);
+            std::string cur = it == store.end() ? std::string() : it->second;
+            apply_atomic(cur, it != store.end(), m.param, m.type);
+            store[m.key] = cur;
+        }
+    }
+    for (const auto &r : tr->write_ranges) {
+        if (r.second.empty()) {
+            write_versions[r.first] = v; //Single key
+        }
+    }
+    last_commit_version = v;
+    *version = v;
+    return 0;
+}
+
+void add_write(FDBTransaction *tr, mutation &&m) {
+    if (!tr->next_write_no_conflict) {
+        tr->write_ranges.push_back(std::make_pair(m.key, m.type == MUTATION_CLEAR_RANGE ? m.param : std::string()));
+    }
+    tr->next_write_no_conflict = false;
+    tr->mutations.push_back(std::move(m));
+}
+
+bool is_retryable(fdb_error_t e) {
+    switch (e) {
+        case ERR_TX_TOO_OLD:
+        case ERR_FUTURE_VERSION:
+        case ERR_NOT_COMMITTED:
+        case 1021: //commit_unknown_result
+        case 1037: //process_behind
+        case 1038: //database_locked
+            return true;
+        default:
+            return false;
+    }
+}
+
+}
+
+extern "C" {
+
+DLLEXPORT const char *fdb_get_error(fdb_error_t code) {
+    switch (code) {
+        case 0:
+            return "Success";
+        case ERR_TX_TOO_OLD:
+            return "Transaction is too old to perform reads or be committed";
+        case ERR_FUTURE_VERSION:
+            return "Request for future version";
+        case ERR_NOT_COMMITTED:
+            return "Transaction not committed due to conflict with another transaction";
+        case 1021:
+            return "Transaction may or may not have committed";
+        case ERR_CANCELLED:
+            return "Operation aborted because the transaction was cancelled";
+        case ERR_INVALID_OPTION:
+            return "Option not valid in this context";
+        case ERR_API_VERSION:
+            return "API version not valid";
+        default:
+            return "Unknown error";
+    }
+}
+
+DLLEXPORT fdb_bool_t fdb_error_predicate(int predicate_test, fdb_error_t code) {
+    switch (predicate_test) {
+        case FDB_ERROR_PREDICATE_RETRYABLE:
+            return is_retryable(code);
+        case FDB_ERROR_PREDICATE_MAYBE_COMMITTED:
+            return code == 1021;
+        case FDB_ERROR_PREDICATE_RETRYABLE_NOT_COMMITTED:
+            return is_retryable(code) && code != 1021;
+        default:
+            return 0;
+    }
+}
+
+DLLEXPORT fdb_error_t fdb_select_api_version_impl(int runtime_version, int header_version) {
+    return runtime_version > header_version ? ERR_API_VERSION : 0;
+}
+
+DLLEXPORT int fdb_get_max_api_version() {
+    return FDB_API_VERSION;
+}
+
+DLLEXPORT const char *fdb_get_client_version() {
+    return FAKE_CLIENT_VERSION;
+}
+
+DLLEXPORT fdb_error_t fdb_network_set_option(FDBNetworkOption option, uint8_t const *value, int value_length) {
+    if (option == FDB_NET_OPTION_KNOB) {
+        const std::string knob((const char *) value, value_length);
+        const std::string name = "fake_latency_us=";
+        if (knob.compare(0, name.size(), name) == 0) {
+            latency_us = strtoull(knob.c_str() + name.size(), nullptr, 10);
+            fprintf(stdout, "[FAKE FDB] Artificial latency set to %lu usec\n", (unsigned long) latency_us.load());
+        } else {
+            fprintf(stdout, "[FAKE FDB] Ignoring knob %s\n", knob.c_str());
+        }
+    }
+    return 0;
+}
+
+DLLEXPORT fdb_error_t fdb_setup_network() {
+    fprintf(stdout, "[FAKE FDB] Using the in-memory fake of libfdb_c. No cluster is contacted\n");
+    return 0;
+}
+
+DLLEXPORT fdb_error_t fdb_run_network() {
+    std::unique_lock<std::mutex> l(net_lock);
+    while (!net_stopped) {
+        if (pending.empty()) {
+            net_cv.wait(l);
+            continue;
+        }
+        const auto due = pending.top().first;
+        if (std::chrono::steady_clock::now() < due) {
+            net_cv.wait_until(l, due);
+            continue;
+        }
+        FDB_future *f = pending.top().second;
+        pending.pop();
+        l.unlock();
+        complete(f);
+        unref(f);
+        l.lock();
+    }
+    return 0;
+}
+
+DLLEXPORT fdb_error_t fdb_stop_network() {
+    {
+        std::lock_guard<std::mutex> l(net_lock);
+        net_stopped = true;
+    }
+    net_cv.notify_all();
+    return 0;
+}
+
+DLLEXPORT fdb_error_t fdb_add_network_thread_completion_hook(void (*hook)(void *), void *hook_parameter) {
+    return 0;
+}
+
+DLLEXPORT void fdb_future_cancel(FDBFuture *f) {
+}
+
+DLLEXPORT void fdb_future_release_memory(FDBFuture *f) {
+}
+
+DLLEXPORT void fdb_future_destroy(FDBFuture *f) {
+    unref(f);
+}
+
+DLLEXPORT fdb_error_t fdb_future_block_until_ready(FDBFuture *f) {
+    std::unique_lock<std::mutex> l(f->m);
+    f->cv.wait(l, [f] { return f->ready; });
+    return 0;
+}
+
+DLLEXPORT fdb_bool_t fdb_future_is_ready(FDBFuture *f) {
+    std::lock_guard<std::mutex> l(f->m);
+    return f->ready;
+}
+
+DLLEXPORT fdb_error_t fdb_future_set_callback(FDBFuture *f, FDBCallback callback, void *callback_parameter) {
+    {
+        std::lock_guard<std::mutex> l(f->m);
+        if (!f->ready) {
+            f->cb = callback;
+            f->cb_param = callback_parameter;
+            return 0;
+        }
+    }
+    //Already ready: the callback is invoked right away, like in FDB
+    callback(f, callback_parameter);
+    return 0;
+}
+
+DLLEXPORT fdb_error_t fdb_future_get_error(FDBFuture *f) {
+    return f->err;
+}
+
+DLLEXPORT fdb_error_t fdb_future_get_int64(FDBFuture *f, int64_t *out) {
+    *out = f->i64;
+    return f->err;
+}
+
+DLLEXPORT fdb_error_t fdb_future_get_key(FDBFuture *f, uint8_t const **out_key, int *out_key_length) {
+    *out_key = (uint8_t const *) f->key.data();
+    *out_key_length = (int) f->key.size();
+    return f->err;
+}
+
+DLLEXPORT fdb_error_t fdb_future_get_value(FDBFuture *f, fdb_bool_t *out_present, uint8_t const **out_value,
+                                           int *out_value_length) {
+    *out_present = f->present;
+    *out_value = (uint8_t const *) f->value.data();
+    *out_value_length = (int) f->value.size();
+    return f->err;
+}
+
+DLLEXPORT fdb_error_t fdb_future_get_keyvalue_array(FDBFuture *f, FDBKeyValue const **out_kv, int *out_count,
+                                                    fdb_bool_t *out_more) {
+    *out_kv = f->kv_view.data();
+    *out_count = (int) f->kv_view.size();
+    *out_more = f->more;
+    return f->err;
+}
+
+DLLEXPORT fdb_error_t fdb_future_get_string_array(FDBFuture *f, const char ***out_strings, int *out_count) {
+    *out_strings = nullptr;
+    *out_count = 0;
+    return f->err;
+}
+
+DLLEXPORT fdb_error_t fdb_create_database(const char *cluster_file_path, FDBDatabase **out_database) {
+    *out_database = new FDB_database();
+    return 0;
+}
+
+DLLEXPORT void fdb_database_destroy(FDBDatabase *d) {
+    delete d;
+}
+
+DLLEXPORT fdb_error_t fdb_database_set_option(FDBDatabase *d, FDBDatabaseOption option, uint8_t const *value,
+                                              int value_length) {
+    return 0;
+}
+
+DLLEXPORT fdb_error_t fdb_database_create_transaction(FDBDatabase *d, FDBTransaction **out_transaction) {
+    *out_transaction = new FDB_transaction();
+    return 0;
+}
+
+DLLEXPORT void fdb_transaction_destroy(FDBTransaction *tr) {
+    delete tr;
+}
+
+DLLEXPORT void fdb_transaction_cancel(FDBTransaction *tr) {
+}
+
+DLLEXPORT fdb_error_t fdb_transaction_set_option(FDBTransaction *tr, FDBTransactionOption option,
+                                                 uint8_t const *value, int value_length) {
+    if (option == FDB_TR_OPTION_NEXT_WRITE_NO_WRITE_CONFLICT_RANGE) {
+        tr->next_write_no_conflict = true;
+    }
+    return 0;
+}
+
+DLLEXPORT void fdb_transaction_set_read_version(FDBTransaction *tr, int64_t version) {
+    tr->read_version = version;
+}
+
+DLLEXPORT FDBFuture *fdb_transaction_get_read_version(FDBTransaction *tr) {
+    if (!tr->read_version) {
+        tr->read_version = current_version();
+    }
+    const int64_t rv = tr->read_version;
+    return schedule([rv](FDB_future *f) {
+        f->i64 = rv;
+        return 0;
+    });
+}
+
+DLLEXPORT FDBFuture *fdb_transaction_get(FDBTransaction *tr, uint8_t const *key_name, int key_name_length,
+                                         fdb_bool_t snapshot) {
+    fdb_error_t e = check_read_version(tr);
+    if (e) {
+        return ready_error(e);
+    }
+    const std::string k((const char *) key_name, key_name_length);
+    if (!snapshot) {
+        tr->read_keys.insert(k);
+    }
+    bool present;
+    std::string v;
+    auto w = tr->writes.find(k);
+    if (w != tr->writes.end()) {
+        present = true;
+        v = w->second;
+    } else if (tr->cleared.count(k)) {
+        present = false;
+    } else {
+        std::lock_guard<std::mutex> l(store_lock);
+        auto it = store.find(k);
+        present = it != store.end();
+        if (present) v = it->second;
+    }
+    return schedule([present, v](FDB_future *f) {
+        f->present = present;
+        f->value = v;
+        return 0;
+    });
+}
+
+DLLEXPORT FDBFuture *fdb_transaction_get_key(FDBTransaction *tr, uint8_t const *key_name, int key_name_length,
+                                             fdb_bool_t or_equal, int offset, fdb_bool_t snapshot) {
+    fdb_error_t e = check_read_version(tr);
+    if (e) {
+        return ready_error(e);
+    }
+    std::string out;
+    {
+        std::lock_guard<std::mutex> l(store_lock);
+        bool before_begin;
+        auto it = resolve(std::string((const char *) key_name, key_name_length), or_equal, offset, &before_begin);
+        if (before_begin) {
+            out = "";
+        } else if (it == store.end()) {
+            out = "\xff";
+        } else {
+            out = it->first;
+        }
+    }
+    return schedule([out](FDB_future *f) {
+        f->key = out;
+        return 0;
+    });
+}
+
+DLLEXPORT FDBFuture *fdb_transaction_get_addresses_for_key(FDBTransaction *tr, uint8_t const *key_name,
+                                                           int key_name_length) {
+    return ready_error(0);
+}
+
+DLLEXPORT FDBFuture *fdb_transaction_get_range(FDBTransaction *tr, uint8_t const *begin_key_name,
+                                               int begin_key_name_length, fdb_bool_t begin_or_equal,
+                                               int begin_offset, uint8_t const *end_key_name,
+                                               int end_key_name_length, fdb_bool_t end_or_equal, int end_offset,
+                                               int limit, int target_bytes, FDBStreamingMode mode, int iteration,
+                                               fdb_bool_t snapshot, fdb_bool_t reverse) {
+    fdb_error_t e = check_read_version(tr);
+    if (e) {
+        return ready_error(e);
+    }
+    const std::string b((const char *) begin_key_name, begin_key_name_length);
+    const std::string en((const char *) end_key_name, end_key_name_length);
+    std::vector<std::pair<std::string, std::string>> kvs;
+    bool more = false;
+    int bytes_limit = mode_bytes(mode, iteration);
+    if (target_bytes && (!bytes_limit || target_bytes < bytes_limit)) {
+        bytes_limit = target_bytes;
+    }
+    {
+        std::lock_guard<std::mutex> l(store_lock);
+        bool bb, eb;
+        auto it = resolve(b, begin_or_equal, begin_offset, &bb);
+        auto end = resolve(en, end_or_equal, end_offset, &eb);
+        int bytes = 0;
+        if (!eb) {
+            for (; key_before(it, end); ++it) {
+                if ((limit && (int) kvs.size() >= limit) || (bytes_limit && bytes >= bytes_limit)) {
+                    more = true;
+                    break;
+                }
+                kvs.push_back(*it);
+                bytes += (int) (it->first.size() + it->second.size());
+            }
+        }
+    }
+    if (!snapshot) {
+        tr->read_ranges.push_back(std::make_pair(b, en));
+    }
+    return schedule([kvs, more](FDB_future *f) {
+        f->kvs = kvs;
+        f->kv_view.resize(f->kvs.size());
+        for (size_t i = 0; i < f->kvs.size(); i++) {
+            f->kv_view[i].key = f->kvs[i].first.data();
+            f->kv_view[i].key_length = (int) f->kvs[i].first.size();
+            f->kv_view[i].value = f->kvs[i].second.data();
+            f->kv_view[i].value_length = (int) f->kvs[i].second.size();
+        }
+        f->more = more;
+        return 0;
+    });
+}
+
+DLLEXPORT void fdb_transaction_set(FDBTransaction *tr, uint8_t const *key_name, int key_name_length,
+                                   uint8_t const *value, int value_length) {
+    mutation m;
+    m.type = MUTATION_SET;
+    m.key.assign((const char *) key_name, key_name_length);
+    m.param.assign((const char *) value, value_length);
+    tr->writes[m.key] = m.param;
+    tr->cleared.erase(m.key);
+    add_write(tr, std::move(m));
+}
+
+DLLEXPORT void fdb_transaction_atomic_op(FDBTransaction *tr, uint8_t const *key_name, int key_name_length,
+                                         uint8_t const *param, int param_length, FDBMutationType operation_type) {
+    mutation m;
+    m.type = operation_type;
+    m.key.assign((const char *) key_name, key_name_length);
+    m.param.assign((const char *) param, param_length);
+    tr->writes.erase(m.key); //We do not evaluate atomic ops for RYW
+    add_write(tr, std::move(m));
+}
+
+DLLEXPORT void fdb_transaction_clear(FDBTransaction *tr, uint8_t const *key_name, int key_name_length) {
+    mutation m;
+    m.type = MUTATION_CLEAR;
+    m.key.assign((const char *) key_name, key_name_length);
+    tr->writes.erase(m.key);
+    tr->cleared.insert(m.key);
+    add_write(tr, std::move(m));
+}
+
+DLLEXPORT void fdb_transaction_clear_range(FDBTransaction *tr, uint8_t const *begin_key_name,
+                                           int begin_key_name_length, uint8_t const *end_key_name,
+                                           int end_key_name_length) {
+    mutation m;
+    m.type = MUTATION_CLEAR_RANGE;
+    m.key.assign((const char *) begin_key_name, begin_key_name_length);
+    m.param.assign((const char *) end_key_name, end_key_name_length);
+    tr->writes.erase(tr->writes.lower_bound(m.key), tr->writes.lower_bound(m.param));
+    add_write(tr, std::move(m));
+}
+
+DLLEXPORT FDBFuture *fdb_transaction_watch(FDBTransaction *tr, uint8_t const *key_name, int key_name_length) {
+    return ready_error(ERR_CANCELLED);
+}
+
+DLLEXPORT FDBFuture *fdb_transaction_commit(FDBTransaction *tr) {
+    return schedule([tr](FDB_future *f) {
+        std::lock_guard<std::mutex> l(store_lock);
+        int64_t v;
+        fdb_error_t e = commit_locked(tr, &v);
+        if (!e) {
+            tr->committed_version = v;
+        }
+        return e;
+    });
+}
+
+DLLEXPORT fdb_error_t fdb_transaction_get_committed_version(FDBTransaction *tr, int64_t *out_version) {
+    *out_version = tr->committed_version;
+    return 0;
+}
+
+DLLEXPORT FDBFuture *fdb_transaction_get_approximate_size(FDBTransaction *tr) {
+    int64_t size = 0;
+    for (const mutation &m : tr->mutations) {
+        size += m.key.size() + m.param.size();
+    }
+    return schedule([size](FDB_future *f) {
+        f->i64 = size;
+        return 0;
+    });
+}
+
+DLLEXPORT FDBFuture *fdb_transaction_get_versionstamp(FDBTransaction *tr) {
+    return ready_error(ERR_INVALID_OPTION);
+}
+
+DLLEXPORT FDBFuture *fdb_transaction_on_error(FDBTransaction *tr, fdb_error_t error) {
+    if (!is_retryable(error)) {
+        return ready_error(error);
+    }
+    tr->reset();
+    tr->retries++;
+    return ready_error(0);
+}
+
+DLLEXPORT void fdb_transaction_reset(FDBTransaction *tr) {
+    tr->reset();
+    tr->retries = 0;
+}
+
+DLLEXPORT fdb_error_t fdb_transaction_add_conflict_range(FDBTransaction *tr, uint8_t const *begin_key_name,
+                                                         int begin_key_name_length, uint8_t const *end_key_name,
+                                                         int end_key_name_length, FDBConflictRangeType type) {
+    std::pair<std::string, std::string> r(std::string((const char *) begin_key_name, begin_key_name_length),
+                                          std::string((const char *) end_key_name, end_key_name_length));
+    if (type == FDB_CONFLICT_RANGE_TYPE_READ) {
+        tr->read_ranges.push_back(r);
+    } else {
+        tr->write_ranges.push_back(r);
+    }
+    return 0;
+}
+
+}
@@ -15,6 +15,11 @@
 
 
 #include <ticks.hh>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <mutex>
 
 static const int MAX_KEY_SIZE = 2048;
 extern thread_local char tx_sid[20];
@@ -44,7 +49,7 @@ struct op_params_get : public op_params {
     size_t buf_size;
     size_t size_read;
     size_t val_read;
-
+    bool missing_ok = false; //Keys can be deleted by the workload, so a missing key is not an error
 
     op_params_get(char *_key, size_t _key_size, char *_buf, size_t _buf_size) :
             key(_key), key_size(_key_size), buf(_buf), buf_size(_buf_size) {}
@@ -54,58 +59,115 @@ struct op_params_clearall : public op_params {
     op_params_clearall() {}
 };
 
-struct op_params_num_keys : public op_params {
-    //https://stackoverflow.com/questions/20944784/why-is-conversion-from-string-constant-to-char-valid-in-c-but-invalid-in-c
-    char const init_key = '\0';//"0";
-    char const end_key = '\xFF';
-    static const size_t offset = 1 << 10;  //MUST be power of two
+/*
+ * A sub-range [begin, end) of the key space whose keys are counted by fdb_op_num_keys.
+ * The walk state is kept here, so that a retried transaction goes on from where the failed one stopped
+ */
+struct key_count_range {
+    std::string begin;
+    std::string end;
+    std::string last; //Last key counted. Empty before the first step
+    bool started = false;
+    size_t offset; //Keys skipped by the next get_key. Halved when it gets past the end of the range
     size_t num_keys = 0;
+    bool done = false;
+};
 
-    char last_key[MAX_KEY_SIZE];
-    int last_size;
-
+struct op_params_num_keys : public op_params {
+    static const size_t offset = 1 << 10;  //MUST be power of two
+    std::vector<key_count_range> ranges;
 
-    op_params_num_keys() {
-        //We need a power-of-two offset b/c we halve it to find the size of the db
+    //The boundaries split the user key space ("" to \xff) in boundaries.size() + 1 sub-ranges
+    op_params_num_keys(std::vector<std::string> boundaries) {
+        //We need a power-of-two offset b/c we halve it to find the end of a range
         if ((!offset) || (offset & (offset - 1))) {
             FATAL("Offset not power of 2: %zu", offset);
         }
-        memcpy(last_key, &init_key, sizeof(init_key));
-        last_size = sizeof(init_key);
+        std::sort(boundaries.begin(), boundaries.end());
+        boundaries.erase(std::unique(boundaries.begin(), boundaries.end()), boundaries.end());
+        std::string begin;
+        for (const std::string &b: boundaries) {
+            if (b.empty() || (unsigned char) b[0] == 0xFF) {
+                continue;
+            }
+            add_range(begin, b);
+            begin = b;
+        }
+        add_range(begin, std::string("\xff"));
     }
 
+    void add_range(const std::string &begin, const std::string &end) {
+        ranges.emplace_back();
+        ranges.back().begin = begin;
+        ranges.back().end = end;
+        ranges.back().offset = offset;
+    }
+
+    size_t num_keys() const {
+        size_t n = 0;
+        for (const key_count_range &r: ranges) {
+            n += r.num_keys;
+        }
+        return n;
+    }
 };
 
 struct op_params_generic : public op_params {
     int num_op;
     bool *rw;
+    uint8_t *flags; //KV_OP_* options of each op, can be nullptr
+    FDBMutationType atomic_op = FDB_MUTATION_TYPE_ADD; //Of the writes with KV_OP_ATOMIC
+    bool missing_ok = false; //Keys can be deleted by the workload, so a missing key is not an error
     char *keys;
     size_t *key_sizes;
     char **put_values;
     size_t *put_value_sizes;
-    char *get_buffer;
-    size_t get_buffer_size;
+    std::vector<char> &get_buffer; //Grown when the values read do not fit
     size_t *read_values;
-    std::vector<char *> read_values_ptr;
+    std::vector<char *> &read_values_ptr;
     FDBFuture **futures;
 
-    op_params_generic(int _num_op, bool *_rw, char *_keys, size_t *_key_sizes, char **_put_values,
-                      size_t *_put_value_sizes, char *_get_buffer, size_t _get_buffer_size, size_t *_read_values,
+    op_params_generic(int _num_op, bool *_rw, uint8_t *_flags, char *_keys, size_t *_key_sizes, char **_put_values,
+                      size_t *_put_value_sizes, std::vector<char> &_get_buffer, size_t *_read_values,
                       std::vector<char *> &_read_values_ptr, FDBFuture **_futures) :
             num_op(_num_op),
             rw(_rw),
+            flags(_flags),
             keys(_keys),
             key_sizes(_key_sizes),
             put_values(_put_values),
             put_value_sizes(_put_value_sizes),
             get_buffer(_get_buffer),
-            get_buffer_size(_get_buffer_size),
             read_values(_read_values),
             read_values_ptr(_read_values_ptr),
             futures(_futures) {}
 
 };
 
+struct op_params_get_range : public op_params {
+    const char *start_key;
+    size_t start_key_size;
+    const char *end_key;
+    size_t end_key_size;
+    int row_limit; //0 = no limit
+    int byte_limit; //0 = no limit
+    FDBStreamingMode mode;
+    fdb_bool_t snapshot;
+    char *buf;
+    size_t buf_size;
+    std::vector<char *> &kv_ptrs;
+    //Output
+    size_t size_read = 0; //Bytes copied to buf
+    u64 rows = 0, bytes = 0; //Rows and bytes (keys + values) returned by FDB
+
+    op_params_get_range(const char *_start_key, size_t _start_key_size, const char *_end_key, size_t _end_key_size,
+                        int _row_limit, int _byte_limit, FDBStreamingMode _mode, fdb_bool_t _snapshot, char *_buf,
+                        size_t _buf_size, std::vector<char *> &_kv_ptrs) :
+            start_key(_start_key), start_key_size(_start_key_size), end_key(_end_key), end_key_size(_end_key_size),
+            row_limit(_row_limit), byte_limit(_byte_limit), mode(_mode), snapshot(_snapshot), buf(_buf),
+            buf_size(_buf_size), kv_ptrs(_kv_ptrs) {}
+};
+
 struct op_params_put : public op_params {
     const char *key;
     size_t key_size;
@@ -117,19 +179,152 @@ struct op_params_put : public op_params {
 };
 
 
+struct op_params_del : public op_params {
+    const char *key;
+    size_t key_size;
+
+    op_params_del(const char *_key, size_t _key_size) : key(_key), key_size(_key_size) {};
+};
+
+struct op_params_clear_range : public op_params {
+    const char *start_key;
+    size_t start_key_size;
+    size_t max_keys;
+    std::string keys; //Deleted keys, back to back
+    std::vector<size_t> key_sizes;
+
+    op_params_clear_range(const char *_start_key, size_t _start_key_size, size_t _max_keys) :
+            start_key(_start_key), start_key_size(_start_key_size), max_keys(_max_keys) {};
+};
+
 struct op_params_put_bulk : public op_params {
     const char *keys;
     size_t *key_sizes;
-    const char *values;
+    char **values;
     size_t *value_sizes;
     size_t num_ops;
 
-    op_params_put_bulk(const char *_keys, size_t *_key_sizes, const char *_buf, size_t *_buf_size, size_t num) :
+    op_params_put_bulk(const char *_keys, size_t *_key_sizes, char **_buf, size_t *_buf_size, size_t num) :
             keys(_keys), key_sizes(_key_sizes), values(_buf), value_sizes(_buf_size), num_ops(num) {};
 };
 
+/*
+ * Last read version obtained from FDB, and the time (in ticks) at which it was requested, 0 if none.
+ * grv is written before wallclock, so a reader that sees a wallclock sees a version that is at least that recent
+ */
+struct fdb_grv_cache {
+    std::atomic<int64_t> grv;
+    std::atomic<u64> wallclock;
+    //Events of the asynchronous transactions of the thread, not yet reported: GRVs requested to the cluster and
+    //read versions rejected as too old or too new
+    std::atomic<u64> requests;
+    std::atomic<u64> stale;
+    std::atomic<u64> rejected; //wallclock of the last version of the shared cache rejected by the cluster
+
+    fdb_grv_cache() : grv(0), wallclock(0), requests(0), stale(0), rejected(0) {}
+};
+
+/*
+ * Per-thread pool of transaction handles. With reuse, handles are reset with fdb_transaction_reset instead of being
+ * destroyed and created again for every op. Asynchronous transactions are given back by the network thread,
+ * hence the lock
+ */
+struct fdb_tx_pool {
+    std::mutex lock;
+    std::vector<FDBTransaction *> free_tx;
+    bool reuse = false;
+
+    ~fdb_tx_pool() {
+        for (FDBTransaction *tr: free_tx) {
+            fdb_transaction_destroy(tr);
+        }
+    }
+
+    //Returns a transaction in its initial state
+    FDBTransaction *get(FDBDatabase *db) {
+        FDBTransaction *tr = nullptr;
+        if (reuse) {
+            std::lock_guard<std::mutex> guard(lock);
+            if (!free_tx.empty()) {
+                tr = free_tx.back();
+                free_tx.pop_back();
+            }
+        }
+        if (tr != nullptr) {
+            fdb_transaction_reset(tr);
+        } else if (fdb_database_create_transaction(db, &tr)) {
+            FATAL("Could not create transaction");
+        }
+        return tr;
+    }
+
+    void put(FDBTransaction *tr) {
+        if (!reuse) {
+            fdb_transaction_destroy(tr);
+            return;
+        }
+        std::lock_guard<std::mutex> guard(lock);
+        free_tx.push_back(tr);
+    }
+};
+
+/*
+ * State of a generic transaction run asynchronously (see run_fdb_op_async).
+ * It is allocated when the transaction starts, and freed after the completion callback has been invoked
+ */
+struct fdb_async_generic {
+    FDBTransaction *tr = nullptr;
+    fdb_tx_pool *pool = nullptr;
+    int num_op;
+    bool *rw;
+    uint8_t *flags = nullptr; //KV_OP_* options of each op
+    FDBMutationType atomic_op = FDB_MUTATION_TYPE_ADD; //Of the writes with KV_OP_ATOMIC
+    bool missing_ok = false; //Keys can be deleted by the workload, so a missing key is not an error
+    char *keys;
+    size_t *key_sizes;
+    char **put_values;
+    size_t *put_value_sizes;
+    kv_async_cb cb;
+    void *ctx;
+    fdb_grv_cache *grv_cache;
+    std::vector<FDBFuture *> futures;
+    std::atomic<int> pending_reads;
+    int rc = 0;
+    bool fresh_grv = false; //Bypass the GRV cache at the next attempt
+    bool bulk = false; //Bulk insert: all ops are writes (rw is not used), without write conflict ranges
+    uint64_t init = 0, begin_latency = 0, commit_latency = 0;
+    uint64_t backoff_init = 0;
+    kv_retry_stats retries;
+
+    fdb_async_generic(int _num_op, bool *_rw, char *_keys, size_t *_key_sizes, char **_put_values,
+                      size_t *_put_value_sizes, kv_async_cb _cb, void *_ctx, fdb_grv_cache *_grv_cache) :
+            num_op(_num_op),
+            rw(_rw),
+            keys(_keys),
+            key_sizes(_key_sizes),
+            put_values(_put_values),
+            put_value_sizes(_put_value_sizes),
+            cb(_cb),
+            ctx(_ctx),
+            grv_cache(_grv_cache),
+            futures(_num_op, nullptr),
+            pending_reads(0) {}
+
+    bool is_ro() const {
+        int i;
+        if (bulk) {
+            return false;
+        }
+        for (i = 0; i < num_op; i++) {
+            if (rw[i]) return false;
+        }
+        return true;
+    }
+};
+
 enum fdb_ops {
-    GRV = 0, COMMIT = 1, GENERIC=2, GET=3, PUT,DELETE=4, CLEAR_ALL=5, GET_NUM_KEYS=6, PUT_BULK=7
+    GRV = 0, COMMIT = 1, GENERIC=2, GET=3, PUT,DELETE=4, CLEAR_ALL=5, GET_NUM_KEYS=6, PUT_BULK=7, GET_RANGE=8,
+    CLEAR_RANGE=9
 };
 
 struct fdb_op_g {
@@ -161,6 +356,52 @@ struct fdb_op : public fdb_op_g {
 #define SNAPSHOT_READ 1
 #define SERIALIZABLE_READ 0
 
+#define FDB_KEY_SIZE_LIMIT 10000
+
+//Adds [key, key + '\0'), i.e., only key, as a conflict range of the given type
+static inline void fdb_add_key_conflict(FDBTransaction *tr, const char *key, size_t key_size,
+                                        FDBConflictRangeType type) {
+    static thread_local uint8_t end[FDB_KEY_SIZE_LIMIT + 1];
+    if (key_size > FDB_KEY_SIZE_LIMIT) {
+        FATAL("Key of %zu bytes is larger than the FDB limit (%u)", key_size, FDB_KEY_SIZE_LIMIT);
+    }
+    memcpy(end, key, key_size);
+    end[key_size] = 0;
+    fdb_error_t err = fdb_transaction_add_conflict_range(tr, (const uint8_t *) key, key_size, end, key_size + 1, type);
+    if (err) {
+        FATAL("%s", fdb_get_error(err));
+    }
+}
+
+//Read of a generic transaction, with its KV_OP_* options
+static inline FDBFuture *fdb_generic_get(FDBTransaction *tr, const char *key, size_t key_size, uint8_t flags) {
+    if (flags & KV_OP_ADD_CONFLICT) {
+        fdb_add_key_conflict(tr, key, key_size, FDB_CONFLICT_RANGE_TYPE_READ);
+    }
+    return fdb_transaction_get(tr, (const uint8_t *) key, key_size,
+                               (flags & KV_OP_NO_CONFLICT) ? SNAPSHOT_READ : SERIALIZABLE_READ);
+}
+
+//Write of a generic transaction, with its KV_OP_* options. Atomic mutations are of type atomic_op
+static inline void fdb_generic_set(FDBTransaction *tr, const char *key, size_t key_size, const char *value,
+                                   size_t value_size, uint8_t flags, FDBMutationType atomic_op) {
+    if (flags & KV_OP_NO_CONFLICT) {
+        fdb_error_t err = fdb_transaction_set_option(tr, FDB_TR_OPTION_NEXT_WRITE_NO_WRITE_CONFLICT_RANGE, nullptr, 0);
+        if (err) {
+            FATAL("%s", fdb_get_error(err));
+        }
+    }
+    if (flags & KV_OP_ADD_CONFLICT) {
+        fdb_add_key_conflict(tr, key, key_size, FDB_CONFLICT_RANGE_TYPE_WRITE);
+    }
+    if (flags & KV_OP_ATOMIC) {
+        fdb_transaction_atomic_op(tr, (const uint8_t *) key, key_size, (const uint8_t *) value, value_size,
+                                  atomic_op);
+    } else {
+        fdb_transaction_set(tr, (const uint8_t *) key, key_size, (const uint8_t *) value, value_size);
+    }
+}
+
 struct fdb_op_clearall : public fdb_op<op_params_clearall> {
     fdb_op_clearall(op_params_clearall *p) : fdb_op<op_params_clearall>(p) {}
 
@@ -195,25 +436,53 @@ struct fdb_op_generic : public fdb_op<op_params_generic> {
 	    }
 	    return true;    	    
     }
+    /*
+     * Appends a value read to the get buffer, and its address (nullptr for a missing key) to read_values_ptr. The buffer
+     * is only grown when the values do not fit, so its size follows the largest transactions of the thread
+     */
+    void copy_value(const uint8_t *value, size_t len) {
+        std::vector<char> &buf = params->get_buffer;
+        const size_t used = *params->read_values;
+        if (value == nullptr) {
+            params->read_values_ptr.push_back(nullptr);
+            return;
+        }
+        if (used + len > buf.size()) {
+            std::vector<char> grown(std::max(2 * buf.size(), used + len));
+            memcpy(grown.data(), buf.data(), used);
+            for (char *&p: params->read_values_ptr) {
+                if (p) p = grown.data() + (p - buf.data());
+            }
+            buf.swap(grown);
+        }
+        memcpy(buf.data() + used, value, len);
+        params->read_values_ptr.push_back(buf.data() + used);
+        *params->read_values = used + len;
+    }
+
     op_result run(FDBTransaction *tr) {
         int done = 0;
         int put_index = 0;
         int rc = 0;
-        char *value_ptr = params->put_values[0], *key_ptr = params->keys;
+        char *key_ptr = params->keys;
+        //Retries start over
+        *params->read_values = 0;
+        params->read_values_ptr.clear();
         while (done < params->num_op) {
+            const uint8_t flags = params->flags ? params->flags[done] : 0;
             if (params->rw[done]) {
+                //Values are only looked up for the writes: put_values has one entry per write (one for OP_ATOMIC)
+                char *value_ptr = params->put_values[put_index];
                 TRACE_FORMAT("%d PUTTING key %.*s on address(%p) with size %zu and  value %.*s", done,
                              (int) params->key_sizes[done], key_ptr, value_ptr, params->put_value_sizes[put_index],
                              (int) params->put_value_sizes[put_index], value_ptr);
-                fdb_transaction_set(tr, (uint8_t *) key_ptr, params->key_sizes[done],
-                                    (uint8_t *) value_ptr, params->put_value_sizes[put_index]);
+                fdb_generic_set(tr, key_ptr, params->key_sizes[done], value_ptr, params->put_value_sizes[put_index],
+                                flags, params->atomic_op);
                 put_index++;
-                value_ptr = params->put_values[put_index];//params->put_value_sizes[put_index];
 
             } else {
                 TRACE_FORMAT("%s %d GETTING key %.*s", tx_sid, done, (int) params->key_sizes[done], key_ptr);
-                params->futures[done] = fdb_transaction_get(tr, (uint8_t *) key_ptr,
-                                                            params->key_sizes[done], SERIALIZABLE_READ);
+                params->futures[done] = fdb_generic_get(tr, key_ptr, params->key_sizes[done], flags);
             }
             key_ptr += params->key_sizes[done];
             done++;
@@ -240,16 +509,15 @@ struct fdb_op_generic : public fdb_op<op_params_generic> {
                 if (e) {
                     return op_result(0, e);
                 } else {
-                    if (!present) {
+                    if (!present && !params->missing_ok) {
                         PRINT_FORMAT("WARNING: Value not found for key %.*s", (int) params->key_sizes[done], key_ptr);
                         rc = 2;
                     } else {
                         TRACE_FORMAT("Read %s length %d", outValue, outValueLength);
                     }
                 }
-                //ALL good, now we have to copy results to user supplied buffers
-                // FIXME @ddi: copy to usr buffer
                 TRACE_FORMAT("%.*s => %.*s", (int) params->key_sizes[done], key_ptr, outValueLength, (char *) outValue);
+                copy_value(present ? outValue : nullptr, (size_t) outValueLength);
             }
             key_ptr += params->key_sizes[done];
             done++;
@@ -262,19 +530,17 @@ struct fdb_op_generic : public fdb_op<op_params_generic> {
 /*
    Solution inspired from the discussion at https://forums.foundationdb.org/t/getting-the-number-of-key-value-pairs/189/4
    Check also https://apple.github.io/foundationdb/developer-guide.html#key-selectors
-   We use the get_key(k,offset) to get the single key at k+offset.
-   We call the function from the start of the keyspace ('') until we get to the end of the range (special key '  ) and
-   we sum the number of scanned keys in the meanwhile
+   We use the get_key(k,offset) to get the single key at k+offset, and we sum the offsets until we get past the end of
+   the range. Past the end, we halve the offset, and we are done when even the next key is past the end.
 
-   Note that an iteration of this algorithm may fail (e.g., a tx with many get_key can last way more than 5 sec).
-   What we do is: we save the last key we tried to get and the number of keys read so far, and we restart a new transaction
-   from that point
+   A single walk of the key space takes one round trip every 1024 keys. So the key space is split in sub-ranges, which
+   are walked at the same time: at every step there is one get_key in flight per sub-range that is not done yet.
 
-   Note that the restarting is transparent because it is done by the "run" function that we implement in the FDBKVstore
+   Note that a transaction with many get_key can last way more than 5 sec and fail. The position of every walk is saved
+   in the params, so the restarting is transparent: it is done by the "run" function that we implement in the FDBKVstore
    (the errors returned in case a tx fail in this case are not critical, so the tx is retried transparently to this code)
  */
 struct fdb_op_num_keys : public fdb_op<op_params_num_keys> {
-//#define RETRY_GETCOUNT
     fdb_op_num_keys(op_params_num_keys *p) : fdb_op<op_params_num_keys>(p) {}
 
     const char *str() { return "get_num_keys"; }
@@ -282,82 +548,62 @@ struct fdb_op_num_keys : public fdb_op<op_params_num_keys> {
     const fdb_ops op() { return GET_NUM_KEYS; }
 
     op_result run(FDBTransaction *tr) {
-        FDBFuture *f, *f_old = nullptr;
-        uint8_t *last = (uint8_t * ) & params->last_key[0];// & params->init_key;
-        uint8_t *out_value;
-        int last_size = params->last_size;
-        size_t it = 0;
-
-        TRACE_FORMAT("GET_KEYS INIT: last %.*s of size %d", last_size, (char *) last, last_size);
-
-        size_t off = params->offset;
-
-        while (1) {
-            TRACE_FORMAT("ITERATION %zu start %.*s Offset %zu", it, last_size, last, off);
-
-            f = fdb_transaction_get_key(tr, (const uint8_t *) last, last_size, true, off, SNAPSHOT_READ);
-
-            fdb_error_t e = fdb_future_block_until_ready(f);
-            if (e) {
-                TRACE_FORMAT("ERROR IN TX GETTING FUTURE");
-
-                //Remember to copy this before destroying the future, which holds the content of the variables
-                memcpy(params->last_key, last, last_size);
-                params->last_size = last_size;
-                TRACE_FORMAT("NEXT last is going to be %.*s", (int) last_size, params->last_key);
-                fdb_future_destroy(f);
-                if (f_old != nullptr)fdb_future_destroy(f_old);
-                return op_result(0, e);
-            }
-
-            int outValueLength;
-
-            e = fdb_future_get_key(f, (const uint8_t **) &out_value, &outValueLength);
-            if (e) {
-                TRACE_FORMAT("ERROR IN FUTURE GETTING KEY");
-                //Remember to copy this before destroying the future, which holds the content of the variables
-                memcpy(params->last_key, last, last_size);
-                params->last_size = last_size;
-                TRACE_FORMAT("NEXT last is going to be %.*s", (int) last_size, params->last_key);
-
-                fdb_future_destroy(f);
-                if (f_old != nullptr)fdb_future_destroy(f_old);
-
-                return op_result(0, e);
+        std::vector<key_count_range> &ranges = params->ranges;
+        std::vector<FDBFuture *> futures(ranges.size(), nullptr);
+        size_t i, it = 0, pending = ranges.size();
+
+        while (pending) {
+            for (i = 0; i < ranges.size(); i++) {
+                key_count_range &r = ranges[i];
+                if (r.done) {
+                    continue;
+                }
+                //The first step selects the offset-th key >= begin, the next ones the offset-th key > last
+                const std::string &base = r.started ? r.last : r.begin;
+                futures[i] = fdb_transaction_get_key(tr, (const uint8_t *) base.data(), (int) base.size(), r.started,
+                                                     (int) r.offset, SNAPSHOT_READ);
             }
-
-
-            if ((int) *out_value == 255) {//This is the end key apparently.
-                //We have reached the end. There are two cases
-                //1. We are out of range because our offset was too large. Then we halve the offset and continue
-                //2. We have really reached the end. This condition is true if offset is 1. Then we return
-                if (off == 1) {
-                    TRACE_FORMAT("End of scan at iteration %zu with %zu keys", it, params->num_keys);
-                    fdb_future_destroy(f);
-                    if (f_old != nullptr)fdb_future_destroy(f_old);
-                    return op_result(0, 0);
-                } else {
-                    TRACE_FORMAT("Reached end of store. Halving offset");
-                    off = off >> 1;
-                    //We keep the last and last_size at the current value
+            fdb_error_t first_e = 0;
+            for (i = 0; i < ranges.size(); i++) {
+                if (futures[i] == nullptr) {
+                    continue;
                 }
-            } else {
-                TRACE_FORMAT("Out key %.*s of size %d", outValueLength, (char *) out_value, outValueLength);
-                if (outValueLength == 1) {
-                    PRINT_FORMAT("actually a char %c %d", *out_value, (int) *out_value);
+                key_count_range &r = ranges[i];
+                const uint8_t *out_key;
+                int out_key_length;
+                fdb_error_t e = fdb_future_block_until_ready(futures[i]);
+                if (!e) {
+                    e = fdb_future_get_key(futures[i], &out_key, &out_key_length);
+                }
+                if (e) {
+                    TRACE_FORMAT("ERROR IN GETTING KEY of range %zu", i);
+                    if (!first_e) first_e = e;
+                } else {
+                    if (r.end.compare(0, std::string::npos, (const char *) out_key, out_key_length) <= 0) {
+                        //Out of range because our offset was too large, or we have really reached the end
+                        if (r.offset == 1) {
+                            TRACE_FORMAT("End of range %zu at iteration %zu with %zu keys", i, it, r.num_keys);
+                            r.done = true;
+                            pending--;
+                        } else {
+                            r.offset >>= 1;
+                        }
+                    } else {
+                        r.last.assign((const char *) out_key, out_key_length);
+                        r.started = true;
+                        r.num_keys += r.offset;
+                    }
                 }
-                last = out_value;
-                last_size = outValueLength;
-                params->num_keys += off;
-                TRACE_FORMAT("Keys now %zu", params->num_keys);
+                fdb_future_destroy(futures[i]);
+                futures[i] = nullptr;
+            }
+            if (first_e) {
+                //The walks whose step completed keep their progress, the others redo it in the next attempt
+                return op_result(0, first_e);
             }
-
-            f_old = f;
             ++it;
-            //We need to be able to reference last and last_size, which belong to the future of the just-past invocation
-            //So we do not destroy it until we advance to a new base key
-
         }
+        return op_result(0, 0);
     }
 
     const bool is_ro(){return true;}
@@ -393,8 +639,11 @@ struct fdb_op_get : public fdb_op<op_params_get> {
         }
 
         if (!present) {
-            PRINT_FORMAT("WARNING: Value not found for key %.*s", (int) params->key_size, params->key);
-            rc = 2;
+            params->val_read = params->size_read = 0;
+            if (!params->missing_ok) {
+                PRINT_FORMAT("WARNING: Value not found for key %.*s", (int) params->key_size, params->key);
+                rc = 2;
+            }
         } else {
             //ALL good, now we have to copy results to user supplied buffers
             TRACE_FORMAT("Get key %s value %s size %d", params->key, outValue, outValueLength);
@@ -409,6 +658,89 @@ struct fdb_op_get : public fdb_op<op_params_get> {
     const bool is_ro(){return true;}
 };
 
+/*
+ * Range read of [start_key, end_key). FDB returns the range in pages, whose size depends on the streaming mode and on
+ * the limits. As soon as a page is ready, we request the next one (starting right after the last key of the page),
+ * and only then we consume the page, so that the next round trip overlaps with the copy.
+ * Values are copied back to back in the user buffer as long as they fit, and kv_ptrs points to each of them
+ */
+struct fdb_op_get_range : public fdb_op<op_params_get_range> {
+
+    fdb_op_get_range(op_params_get_range *p) : fdb_op<op_params_get_range>(p) {};
+
+    const char *str() { return "get_range_op"; }
+
+    const fdb_ops op() { return GET_RANGE; }
+
+    const bool is_ro() { return true; }
+
+    op_result run(FDBTransaction *tr) {
+        //We may be retrying after an error
+        params->size_read = 0;
+        params->rows = 0;
+        params->bytes = 0;
+        params->kv_ptrs.clear();
+
+        int iteration = 1;
+        FDBFuture *f = fdb_transaction_get_range(tr,
+                                                 FDB_KEYSEL_FIRST_GREATER_OR_EQUAL((uint8_t *) params->start_key,
+                                                                                   (int) params->start_key_size),
+                                                 FDB_KEYSEL_FIRST_GREATER_OR_EQUAL((uint8_t *) params->end_key,
+                                                                                   (int) params->end_key_size),
+                                                 params->row_limit, params->byte_limit, params->mode, iteration,
+                                                 params->snapshot, 0);
+        while (f != nullptr) {
+            fdb_error_t e = fdb_future_block_until_ready(f);
+            if (e) {
+                fdb_future_destroy(f);
+                return op_result(0, e);
+            }
+            const FDBKeyValue *kvs;
+            int count;
+            fdb_bool_t more;
+            e = fdb_future_get_keyvalue_array(f, &kvs, &count, &more);
+            if (e) {
+                fdb_future_destroy(f);
+                return op_result(0, e);
+            }
+            int i;
+            for (i = 0; i < count; i++) {
+                params->bytes += kvs[i].key_length + kvs[i].value_length;
+            }
+            params->rows += count;
+
+            //Prefetch the next page before consuming this one
+            FDBFuture *next = nullptr;
+            const int rows_left = params->row_limit ? params->row_limit - (int) params->rows : 0;
+            const int bytes_left = params->byte_limit ? params->byte_limit - (int) params->bytes : 0;
+            if (more && count && (!params->row_limit || rows_left > 0) && (!params->byte_limit || bytes_left > 0)) {
+                const FDBKeyValue &last = kvs[count - 1];
+                next = fdb_transaction_get_range(tr,
+                                                 FDB_KEYSEL_FIRST_GREATER_THAN((uint8_t *) last.key, last.key_length),
+                                                 FDB_KEYSEL_FIRST_GREATER_OR_EQUAL((uint8_t *) params->end_key,
+                                                                                   (int) params->end_key_size),
+                                                 rows_left, bytes_left, params->mode, ++iteration,
+                                                 params->snapshot, 0);
+            }
+
+            for (i = 0; i < count; i++) {
+                const size_t len = (size_t) kvs[i].value_length;
+                if (params->size_read + len > params->buf_size) {
+                    break;
+                }
+                char *dst = params->buf + params->size_read;
+                memcpy(dst, kvs[i].value, len);
+                params->kv_ptrs.push_back(dst);
+                params->size_read += len;
+            }
+            fdb_future_destroy(f);
+            f = next;
+        }
+        TRACE_FORMAT("Range read of %lu rows (%lu bytes) in %d pages", params->rows, params->bytes, iteration);
+        return op_result(0, 0);
+    }
+};
+
 struct fdb_op_put : public fdb_op<op_params_put> {
 
     fdb_op_put(op_params_put *p) : fdb_op<op_params_put>(p) {}; //fdb_op_put(op_params_put p) : fdb_op(p) {}
@@ -426,6 +758,95 @@ struct fdb_op_put : public fdb_op<op_params_put> {
     const bool is_ro(){return false;}
 };
 
+struct fdb_op_del : public fdb_op<op_params_del> {
+
+    fdb_op_del(op_params_del *p) : fdb_op<op_params_del>(p) {};
+
+    const char *str() { return "del_op"; }
+
+    const fdb_ops op() { return DELETE; }
+
+    op_result run(FDBTransaction *tr) {
+        TRACE_FORMAT("DELETING key %.*s", (int) params->key_size, params->key);
+        fdb_transaction_clear(tr, (const uint8_t *) params->key, params->key_size);
+        return op_result(0, 0);
+    }
+
+    const bool is_ro() { return false; }
+};
+
+/*
+ * Reads the first max_keys keys >= start_key, and clears the range from start_key to the last of them, so that the
+ * keys it deletes are known (to insert them back) also if keys are not in the order of their index
+ */
+struct fdb_op_clear_range : public fdb_op<op_params_clear_range> {
+
+    fdb_op_clear_range(op_params_clear_range *p) : fdb_op<op_params_clear_range>(p) {};
+
+    const char *str() { return "clear_range_op"; }
+
+    const fdb_ops op() { return CLEAR_RANGE; }
+
+    op_result run(FDBTransaction *tr) {
+        //We may be retrying after an error
+        params->keys.clear();
+        params->key_sizes.clear();
+
+        FDBFuture *f = fdb_transaction_get_range(tr,
+                                                 FDB_KEYSEL_FIRST_GREATER_OR_EQUAL((uint8_t *) params->start_key,
+                                                                                   (int) params->start_key_size),
+                                                 FDB_KEYSEL_FIRST_GREATER_OR_EQUAL((uint8_t *) "\xff", 1),
+                                                 (int) params->max_keys, 0, FDB_STREAMING_MODE_EXACT, 1,
+                                                 SERIALIZABLE_READ, 0);
+        fdb_error_t e = fdb_future_block_until_ready(f);
+        const FDBKeyValue *kvs;
+        int count;
+        fdb_bool_t more;
+        if (!e) {
+            e = fdb_future_get_keyvalue_array(f, &kvs, &count, &more);
+        }
+        if (e) {
+            fdb_future_destroy(f);
+            return op_result(0, e);
+        }
+        int i;
+        for (i = 0; i < count; i++) {
+            params->keys.append((const char *) kvs[i].key, kvs[i].key_length);
+            params->key_sizes.push_back(kvs[i].key_length);
+        }
+        fdb_future_destroy(f);
+        if (count) {
+            //The end of the range is the first key after the last one we read
+            std::string end = params->keys.substr(params->keys.size() - params->key_sizes.back());
+            end.push_back('\0');
+            fdb_transaction_clear_range(tr, (const uint8_t *) params->start_key, params->start_key_size,
+                                        (const uint8_t *) end.data(), end.size());
+        }
+        TRACE_FORMAT("Clearing %d keys", count);
+        return op_result(0, 0);
+    }
+
+    const bool is_ro() { return false; }
+};
+
+/*
+ * Write of a bulk insert: no write conflict range and no read-your-writes.
+ * The options are set before every write, bc apparently doing set resets the flags
+ * https://forums.foundationdb.org/t/best-practices-for-bulk-load/422/6
+ */
+static inline void fdb_bulk_set(FDBTransaction *tr, const char *key, size_t key_size, const char *value,
+                                size_t value_size) {
+    fdb_error_t err = fdb_transaction_set_option(tr, FDB_TR_OPTION_NEXT_WRITE_NO_WRITE_CONFLICT_RANGE, nullptr, 0);
+    if (err) {
+        FATAL("%s", fdb_get_error(err));
+    }
+    err = fdb_transaction_set_option(tr, FDB_TR_OPTION_READ_YOUR_WRITES_DISABLE, nullptr, 0);
+    if (err) {
+        FATAL("%s", fdb_get_error(err));
+    }
+    fdb_transaction_set(tr, (uint8_t *) key, key_size, (uint8_t *) value, value_size);
+}
+
 struct fdb_op_put_bulk : public fdb_op<op_params_put_bulk> {
 
     fdb_op_put_bulk(op_params_put_bulk *p) : fdb_op<op_params_put_bulk>(
@@ -438,33 +859,14 @@ struct fdb_op_put_bulk : public fdb_op<op_params_put_bulk> {
     const bool is_ro(){return false;}
     op_result run(FDBTransaction *tr) {
         u32 i;
-        char *k = (char *) params->keys, *v = (char *) params->values;
+        char *k = (char *) params->keys;
         for (i = 0; i < params->num_ops; i++) {
 
-            TRACE_FORMAT("PUTTING key %.*s %.*s size %zu", (int) params->key_size, params->key,
-                         (int) params->value_size,
-                         params->value, params->value_size);
-
-            /*
-             * Setting flags. Done every time bc apparently doing set resets the flags
-             * https://forums.foundationdb.org/t/best-practices-for-bulk-load/422/6
-             */
-            fdb_error_t err = fdb_transaction_set_option(tr, FDB_TR_OPTION_NEXT_WRITE_NO_WRITE_CONFLICT_RANGE,
-                                                         nullptr, 0);
-            if (err) {
-                FATAL("%s", fdb_get_error(err));
-            }
-
-            err = fdb_transaction_set_option(tr, FDB_TR_OPTION_READ_YOUR_WRITES_DISABLE,
-                                                         nullptr, 0);
-            if (err) {
-                FATAL("%s", fdb_get_error(err));
-            }
+            TRACE_FORMAT("PUTTING key %.*s %.*s size %zu", (int) params->key_sizes[i], k,
+                         (int) params->value_sizes[i], params->values[i], params->value_sizes[i]);
 
-            fdb_transaction_set(tr, (uint8_t *) k, params->key_sizes[i], (uint8_t *) v,
-                                params->value_sizes[i]);
+            fdb_bulk_set(tr, k, params->key_sizes[i], params->values[i], params->value_sizes[i]);
             k += params->key_sizes[i];
-            v += params->value_sizes[i];
         }
 
         return op_result(0, 0);
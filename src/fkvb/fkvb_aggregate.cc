@@ -0,0 +1,201 @@
+/*
+ *  Copyright (c) 2021 International Business Machines
+ *  All rights reserved.
+ *
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Authors: Diego Didona (ddi@zurich.ibm.com),
+ *
+ */
+
+/*
+ * Merges the latency histograms of many fkvb processes (ID.xput.runhist or .loadhist files) by wall-clock second,
+ * and prints the cluster-wide throughput and latency percentiles of each second and of the whole run.
+ * Only the per-process aggregate ("proc") lines are read. Since they are written in increasing order of second,
+ * the files are merged like sorted runs: memory only depends on the number of files, not on their length.
+ * The corrections ("late" lines, for the epochs completed after the aggregate of their second was written) are only
+ * added to the whole run.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <inttypes.h>
+#include "types.hh"
+#include "defs.hh"
+#include "histogram.hh"
+
+struct hist_reader {
+    std::string file;
+    std::ifstream in;
+    std::string line;
+    bool valid;
+    u64 sec;
+    std::string op;
+    histogram h;
+    u64 late; //Lines for seconds that had already been written out
+    std::map<std::string, histogram> corrections; //Of the "late" lines, by op
+    u64 num_corrections;
+
+    hist_reader(const std::string &f, u64 &tics_per_sec) : file(f), in(f.c_str()), valid(true), sec(0), late(0),
+                                                            num_corrections(0) {
+        u32 sub_bits, max_bits;
+        u64 tics;
+        if (in.fail()) {
+            FATAL("Error opening %s", file.c_str());
+        }
+        if (!std::getline(in, line) ||
+            sscanf(line.c_str(), "#sub_bucket_bits %u max_bits %u tics_per_sec %" SCNu64, &sub_bits, &max_bits,
+                   &tics) != 3) {
+            FATAL("%s is not an fkvb histogram file", file.c_str());
+        }
+        if (sub_bits != HIST_SUB_BUCKET_BITS || max_bits != HIST_MAX_BITS) {
+            FATAL("%s has histograms with %u sub bucket bits and %u max bits, expected %u and %u", file.c_str(),
+                  sub_bits, max_bits, HIST_SUB_BUCKET_BITS, HIST_MAX_BITS);
+        }
+        if (!tics) {
+            FATAL("%s does not report the CPU frequency", file.c_str());
+        }
+        //Buckets are in tics, so histograms taken with different frequencies cannot be merged
+        if (tics_per_sec && tics != tics_per_sec) {
+            FATAL("%s uses %" P64 " tics per sec instead of %" P64 ". Run all the clients with the same --freq",
+                  file.c_str(), tics, tics_per_sec);
+        }
+        tics_per_sec = tics;
+        next();
+    }
+
+    //Moves to the next per-process line. Corrections are set aside on the way
+    void next() {
+        while (std::getline(in, line)) {
+            const bool correction = !line.compare(0, 5, "late ");
+            if (!correction && line.compare(0, 5, "proc ")) {
+                continue;
+            }
+            std::istringstream ss(line.substr(5));
+            if (!(ss >> sec >> op) || !h.deserialize(ss)) {
+                FATAL("Malformed line in %s: %s", file.c_str(), line.c_str());
+            }
+            if (correction) {
+                corrections[op].merge(h);
+                num_corrections++;
+                continue;
+            }
+            return;
+        }
+        valid = false;
+    }
+};
+
+static void print_usage() {
+    printf("Usage: fkvb-aggregate [-o output] file...\n");
+    printf("Files are ID.xput.runhist or ID.xput.loadhist files. For ID.xput.runxput or ID.xput.loadxput, the "
+           "histogram file with the same prefix is read.\n");
+    printf("Output: one line per second and op, and one line per op for the whole run (second = all).\n");
+}
+
+static void write_line(FILE *out, const std::string &wall, const std::string &second, const std::string &op,
+                       const histogram &h, double tics_per_usec) {
+    fprintf(out, "%s %s %s %" P64 " %.2f %.2f %.2f %.2f %.2f %.2f\n", wall.c_str(), second.c_str(), op.c_str(),
+            h.count, h.get_avg() / tics_per_usec, h.get_percentile(0.5) / tics_per_usec,
+            h.get_percentile(0.99) / tics_per_usec, h.get_percentile(0.999) / tics_per_usec,
+            h.get_percentile(0.9999) / tics_per_usec, h.max / tics_per_usec);
+}
+
+int main(const int argc, char *argv[]) {
+    std::vector<hist_reader *> readers;
+    FILE *out = stdout;
+    u64 tics_per_sec = 0;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        if (arg == "-h" || arg == "--help") {
+            print_usage();
+            return 0;
+        } else if (arg == "-o") {
+            if (i + 1 == argc) {
+                FATAL("-o requires a file name");
+            }
+            out = fopen(argv[++i], "w");
+            if (out == nullptr) {
+                FATAL("Error opening %s", argv[i]);
+            }
+        } else {
+            const size_t ext = arg.rfind("xput");
+            if (ext != std::string::npos && ext + 4 == arg.size() && ext > 0 && arg[ext - 1] != '.') {
+                arg.replace(ext, 4, "hist");
+            }
+            readers.push_back(new hist_reader(arg, tics_per_sec));
+        }
+    }
+    if (readers.empty()) {
+        print_usage();
+        return 1;
+    }
+
+    const double tics_per_usec = (double) tics_per_sec / 1000000.0;
+    std::map<std::string, histogram> total;
+    u64 first_sec = 0;
+    bool first = true;
+
+    fprintf(out, "#wall_sec second op count avg_us p50_us p99_us p999_us p9999_us max_us\n");
+    while (true) {
+        //Next second: the smallest one among the current lines of the files
+        u64 cur = ~0ULL;
+        for (hist_reader *r: readers) {
+            if (r->valid && r->sec < cur) {
+                cur = r->sec;
+            }
+        }
+        if (cur == ~0ULL) {
+            break;
+        }
+        if (first) {
+            first_sec = cur;
+            first = false;
+        }
+        std::map<std::string, histogram> second;
+        for (hist_reader *r: readers) {
+            while (r->valid && r->sec <= cur) {
+                if (r->sec < cur) {
+                    r->late++;
+                } else {
+                    second[r->op].merge(r->h);
+                }
+                r->next();
+            }
+        }
+        const std::string wall = std::to_string(cur), sec = std::to_string(cur - first_sec);
+        for (auto &p: second) {
+            write_line(out, wall, sec, p.first, p.second, tics_per_usec);
+            total[p.first].merge(p.second);
+        }
+    }
+    for (hist_reader *r: readers) {
+        for (auto &p: r->corrections) {
+            total[p.first].merge(p.second);
+        }
+    }
+    for (auto &p: total) {
+        write_line(out, "all", "all", p.first, p.second, tics_per_usec);
+    }
+
+    for (hist_reader *r: readers) {
+        if (r->late) {
+            ERROR("%s: skipped %" P64 " lines of seconds that were already merged", r->file.c_str(), r->late);
+        }
+        if (r->num_corrections) {
+            ERROR("%s: %" P64 " late lines only added to the whole run", r->file.c_str(), r->num_corrections);
+        }
+        delete r;
+    }
+    if (out != stdout) {
+        fclose(out);
+    }
+    return 0;
+}
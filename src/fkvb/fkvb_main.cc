@@ -92,6 +92,10 @@ int main(const int argc, char *argv[]) {
 
     //KV -specific params should be sanitized by the KV
     conf.validate_and_sanitize_parameters();
+    if (conf.bench_keys) {
+        bench_key_encoders(&conf);
+        return 0;
+    }
     fkvb_factory *yf = new fkvb_factory();
     fkvb = yf->build_fkvb(&conf);
     if (nullptr == fkvb) {
@@ -12,14 +12,13 @@
 
 
 void fkvb_test_conf::validate_and_sanitize_parameters() {
-    const unsigned int total = read_perc + scan_perc + update_perc + insert_perc + rmw_perc + generic_perc;
+    const unsigned int total =
+            read_perc + scan_perc + update_perc + insert_perc + rmw_perc + atomic_perc + delete_perc +
+            clear_range_perc + generic_perc;
     if (100 != total) {
-        FATAL("Sum of ops is not 100 (but %u). Read %u scan %u update %u insert %u rmw %u generic %u", total, read_perc,
-              scan_perc, update_perc, insert_perc, rmw_perc, generic_perc);
-        exit(1);
-    }
-    if (generic_perc && value_size_gen.find("const") == std::string::npos) {
-        FATAL("Generic ops are only supported with fixed values.")
+        FATAL("Sum of ops is not 100 (but %u). Read %u scan %u update %u insert %u rmw %u atomic %u delete %u "
+              "clear_range %u generic %u", total, read_perc, scan_perc, update_perc, insert_perc, rmw_perc,
+              atomic_perc, delete_perc, clear_range_perc, generic_perc);
         exit(1);
     }
     if (generic_perc && 0 == generic_ops) {
@@ -45,6 +44,66 @@ void fkvb_test_conf::validate_and_sanitize_parameters() {
     if (key_type != "fkvb" && key_type != "random" && key_type !="sharded_fkvb" && key_type !="sharded_random") {
         FATAL("key_type must be (sharded_)fkvb or (sharded_)random or ");
     }
+    if (target_rate) {
+        if (arrival != "poisson" && arrival != "const") {
+            FATAL("arrival must be poisson or const");
+        }
+        if (sleep_time_us) {
+            FATAL("--target_rate and --sleep_time_us are mutually exclusive");
+        }
+        if (thread_nr_m && target_rate < thread_nr_m) {
+            FATAL("--target_rate (%u) must be at least one op/s per thread (%u threads)", target_rate, thread_nr_m);
+        }
+    }
+    if (scan_mode != "want_all" && scan_mode != "iterator" && scan_mode != "exact" && scan_mode != "small" &&
+        scan_mode != "medium" && scan_mode != "large" && scan_mode != "serial") {
+        FATAL("scan_mode must be want_all, iterator, exact, small, medium, large or serial");
+    }
+    if (scan_mode == "exact" && !scan_row_limit) {
+        FATAL("--scan_mode exact requires --scan_row_limit");
+    }
+    if (!tx_in_flight) {
+        FATAL("--tx_in_flight must be at least 1");
+    }
+    if (tx_in_flight > 1) {
+        if (generic_perc != 100) {
+            FATAL("--tx_in_flight > 1 is only supported with --generic_perc 100 (%u)", generic_perc);
+        }
+        if (sleep_time_us) {
+            FATAL("--tx_in_flight > 1 and --sleep_time_us are mutually exclusive");
+        }
+    }
+    if (generic_snapshot_perc > 100 || generic_no_conflict_perc > 100 || generic_conflict_perc > 100) {
+        FATAL("--generic_snapshot_perc (%u), --generic_no_conflict_perc (%u) and --generic_conflict_perc (%u) must be "
+              "at most 100", generic_snapshot_perc, generic_no_conflict_perc, generic_conflict_perc);
+    }
+    if (generic_atomic_perc > 100) {
+        FATAL("--generic_atomic_perc (%u) must be at most 100", generic_atomic_perc);
+    }
+    if (!atomic_size || atomic_size > MAX_ATOMIC_SIZE) {
+        FATAL("--atomic_size (%u) must be between 1 and %u", atomic_size, MAX_ATOMIC_SIZE);
+    }
+    if (atomic_keys > num_keys) {
+        FATAL("--atomic_keys (%u) must be at most --num_keys (%u)", atomic_keys, num_keys);
+    }
+    if (!bulk_keys || !bulk_in_flight) {
+        FATAL("--bulk_keys and --bulk_in_flight must be at least 1");
+    }
+    if (bulk_bytes > MAX_BULK_BYTES) {
+        FATAL("--bulk_bytes (%u) must be at most %u", bulk_bytes, MAX_BULK_BYTES);
+    }
+    if (count_ranges > MAX_COUNT_RANGES) {
+        FATAL("--count_ranges (%u) must be at most %u", count_ranges, MAX_COUNT_RANGES);
+    }
+    if (key_size_gen == UNIFORM) {
+        FATAL("--key_size uniform requires bounds (uniformx_y)");
+    }
+    if (!(value_compression > 0 && value_compression <= 1)) {
+        FATAL("--value_compression (%f) must be in (0, 1]", value_compression);
+    }
+    if (grv_cache_shared && !grv_cache_ms) {
+        FATAL("--grv_cache_shared requires --grv_cache_ms");
+    }
     if (config_file == "" && type_m == KV_FDB) {
         FATAL("Config file not specified");
     }
@@ -62,18 +121,36 @@ void fkvb_test_conf::print_usage(const char name[]) {
     printf("Optional arguments (if not set, the corresponding default value is assigned):\n");
     printf("--num_keys: Number of keys. Default = %u).\n", DEFAULT_NUM_KEYS);
     printf("--dap: Data access pattern. It can be \"uniform\" or \"zipfian\". Default = %s\n", DEFAULT_DAP);
-    printf("--ks: Key size. Key with index k is in the form \"User: 0k\", with as many trailing 0s to fill the desired size."
-           " Default = %u (the size of the key should be consistent with the maximum number of digits a key index can take)\n",
-           DEFAULT_KEY_SIZE);
-    printf("--value_size: Distribution of the size of the values in bytes. It can be constx, or uniformx_y. Default = %s\n",
+    printf("--key_size: Distribution of the size of the keys in bytes. It can be x (same as constx), constx, uniformx_y or"
+           " zipfx_y (sizes in [x, y], smaller ones more frequent). The size of a key only depends on its index. With "
+           "the fkvb key type, the key with index k is in the form \"U: 0k\", with as many 0s before k to fill the "
+           "smallest size, and after k to fill the size of the key. Default = %s (the smallest size should be consistent "
+           "with the maximum number of digits a key index can take)\n", DEFAULT_KEY_SIZE_GEN);
+    printf("--value_size: Distribution of the size of the values in bytes. It can be constx, or uniformx_y (x and y "
+           "included). Default = %s\n",
            DEFAULT_VALUE_SIZE_GEN);
+    printf("--value_compression: Target compression ratio (compressed size / size) of the values, in (0, 1]. 1 gives "
+           "random bytes, smaller ratios give more redundant values. Default = %.1f\n", DEFAULT_VALUE_COMPRESSION);
     printf("--read_perc: Percentage of point read operations. Default = %u\n", DEFAULT_READ_PERC);
     printf("--update_perc: Percentage of point update operations. Default = %u\n", DEFAULT_UPDATE_PERC);
     printf("--rmw_perc: Percentage of point read-modify-write operations. Default = %u\n", DEFAULT_RMW_PERC);
     printf("--scan_perc: Percentage of scan operations. Default = %u\n", DEFAULT_SCAN_PERC);
+    printf("--atomic_perc: Percentage of point atomic mutations (see --atomic_op). Default = %u\n", DEFAULT_ATOMIC_PERC);
+    printf("--delete_perc: Percentage of point delete operations. Default = %u\n", DEFAULT_DELETE_PERC);
+    printf("--clear_range_perc: Percentage of clear range operations. Default = %u\n", DEFAULT_CLEAR_RANGE_PERC);
+    printf("--clear_range_len: Distribution of the number of keys deleted by a clear range. It can be constx or"
+           " uniformx_y. Default = %s\n", DEFAULT_CLEAR_RANGE_LENGTH);
+    printf("--reinsert_delay: number of ops after which a thread inserts back the keys it has deleted. Default = %u\n",
+           DEFAULT_REINSERT_DELAY);
+    printf("--count_ranges: number of sub-ranges of the key space counted concurrently to check the number of keys at "
+           "the end of the population and of the test. 0 skips the checks. Default = %u\n", DEFAULT_COUNT_RANGES);
+    printf("--count_wait_sec: max number of seconds that the key check at the end of the population waits for the "
+           "other instances to load their keys. Default = %u\n", DEFAULT_COUNT_WAIT_SEC);
+    printf("--bench_keys: if not 0, do not run a test, but build this many keys of every key type (with --key_size "
+           "and --num_keys) and print the keys/s. Default = %u\n", DEFAULT_BENCH_KEYS);
     printf("--scan_len: Distribution of the length of scan operations. It can be constx or uniformx_y. Default = %s\n",
            DEFAULT_SCAN_LENGTH);
-    printf("--generic_perc: Percentage of generic multi-operation transactions. Default = %u\nNOTE: generic operations are only supported with *fixed* value sizes\n",
+    printf("--generic_perc: Percentage of generic multi-operation transactions. Default = %u\n",
            DEFAULT_GENERIC_PERC);
     printf("--generic_ops: Operations per generic transactions. Default = %u\n", DEFAULT_GENERIC_OPS);
     printf("--generic_rp: Percentage of read operations within a generic transaction (the remainder are updates). Default = %u\n",
@@ -89,6 +166,48 @@ void fkvb_test_conf::print_usage(const char name[]) {
     printf("--key-type: format of the key used. Possible values are fkvb and random (default %s). Keys have a prefix and a numerical suffix id"
            "to make them unique. fkvb keys have the suffix of the form User: 00...00N. random keys have a random prefix followed by the id N",
            DEFAULT_KEY_TYPE);
+    printf("--sleep_time_us: think time in usec between two consecutive transactions of a thread (closed loop). Default = 0\n");
+    printf("--target_rate: open-loop mode. Aggregate number of transactions per second issued by the process, split evenly across threads."
+           " Latencies are measured from the intended send time. Default = %u (closed loop)\n", DEFAULT_TARGET_RATE);
+    printf("--arrival: inter-arrival distribution in open-loop mode. It can be poisson or const. Default = %s\n",
+           DEFAULT_ARRIVAL);
+    printf("--tx_in_flight: number of generic transactions that each thread keeps outstanding. If > 1, transactions are"
+           " run asynchronously. Only supported with --generic_perc 100. Default = %u\n", DEFAULT_TX_IN_FLIGHT);
+    printf("--scan_mode: FDB streaming mode of range reads. It can be want_all, iterator, exact, small, medium, large or"
+           " serial. Default = %s\n", DEFAULT_SCAN_MODE);
+    printf("--scan_row_limit: max number of rows returned by a range read (required by exact). Default = 0 (no limit)\n");
+    printf("--scan_byte_limit: max number of bytes returned by a range read. Default = 0 (no limit)\n");
+    printf("--scan_snapshot: if 1, range reads are snapshot reads, i.e., they do not add read conflict ranges."
+           " Default = 0\n");
+    printf("--tx_reuse: if 1, each thread reuses its FDB transaction handles by resetting them, instead of creating and"
+           " destroying a transaction for every op. Default = 1\n");
+    printf("--generic_snapshot_perc: percentage of the reads of generic transactions that are snapshot reads, i.e.,"
+           " that do not add a read conflict range. Default = 0\n");
+    printf("--generic_no_conflict_perc: percentage of the writes of generic transactions that do not add a write"
+           " conflict range. Default = 0\n");
+    printf("--generic_conflict_perc: percentage of the ops of generic transactions that add their key as an explicit"
+           " conflict range (read or write, as the op). Default = 0\n");
+    printf("--generic_atomic_perc: percentage of the writes of generic transactions that are atomic mutations."
+           " Default = 0\n");
+    printf("--atomic_op: type of atomic mutations: add, and, or, xor, max, min, byte_max, byte_min, append_if_fits."
+           " Default = %s\n", DEFAULT_ATOMIC_OP);
+    printf("--atomic_size: size in bytes of the operand of atomic mutations. For add, it is the integer 1 (little"
+           " endian), otherwise random bytes. Default = %u\n", DEFAULT_ATOMIC_SIZE);
+    printf("--atomic_keys: if not 0, atomic mutations only go to the first atomic_keys keys (hot counters)."
+           " Default = 0\n");
+    printf("--bulk_keys: max number of keys inserted by one transaction during the population. A transaction is"
+           " also closed once its keys and values reach %u bytes. Default = %u\n", MAX_BULK_BYTES, DEFAULT_BULK_KEYS);
+    printf("--bulk_bytes: if not 0, a population transaction is committed as soon as its keys and values reach this"
+           " size, whatever its number of keys (--bulk_keys is ignored). At most %u. Default = 0\n", MAX_BULK_BYTES);
+    printf("--bulk_in_flight: number of population transactions that each population thread keeps committing."
+           " Default = %u\n", DEFAULT_BULK_IN_FLIGHT);
+    printf("--grv_cache_ms: max age in ms of a cached read version (GRV) used to start a transaction. Default = 0 (a new"
+           " GRV for every transaction)\n");
+    printf("--grv_cache_shared: if 1, the GRV cache is shared by all the threads of the process and refreshed by a"
+           " background thread every grv_cache_ms/2 ms, so that threads do not wait for GRVs. Default = 0\n");
+    printf("--start_at: wall-clock time, in seconds since the UNIX epoch, at which the client threads start measuring."
+           " Give the same value to all the processes on a host to align their start. Default = 0 (start as soon as all"
+           " threads of the process are ready)\n");
     printf("\n");
 }
 
@@ -162,6 +281,82 @@ int fkvb_test_conf::parse_args(ParseArgs &args) {
                                  PRIu8, rmw_perc);
             ++i;
             continue;
+        } else if ("--atomic_perc" == arg) {
+            atomic_perc = stoul(val);
+            args.used_arg_and_val(i);
+            PRINT_FORMAT("Atomic perc is %"
+                                 PRIu8, atomic_perc);
+            ++i;
+            continue;
+        } else if ("--delete_perc" == arg) {
+            delete_perc = stoul(val);
+            args.used_arg_and_val(i);
+            PRINT_FORMAT("Delete perc is %"
+                                 PRIu8, delete_perc);
+            ++i;
+            continue;
+        } else if ("--clear_range_perc" == arg) {
+            clear_range_perc = stoul(val);
+            args.used_arg_and_val(i);
+            PRINT_FORMAT("Clear range perc is %"
+                                 PRIu8, clear_range_perc);
+            ++i;
+            continue;
+        } else if ("--clear_range_len" == arg) {
+            clear_range_len_gen = val;
+            args.used_arg_and_val(i);
+            PRINT_FORMAT("Clear range length is %s", clear_range_len_gen.c_str());
+            ++i;
+            continue;
+        } else if ("--reinsert_delay" == arg) {
+            reinsert_delay = (u32) stoul(val);
+            args.used_arg_and_val(i);
+            PRINT_FORMAT("Reinsert delay is %u", reinsert_delay);
+            ++i;
+            continue;
+        } else if ("--count_ranges" == arg) {
+            count_ranges = (u32) stoul(val);
+            args.used_arg_and_val(i);
+            PRINT_FORMAT("Key count ranges are %u", count_ranges);
+            ++i;
+            continue;
+        } else if ("--count_wait_sec" == arg) {
+            count_wait_sec = (u32) stoul(val);
+            args.used_arg_and_val(i);
+            PRINT_FORMAT("Key count wait is %u sec", count_wait_sec);
+            ++i;
+            continue;
+        } else if ("--bench_keys" == arg) {
+            bench_keys = (u64) stoull(val);
+            args.used_arg_and_val(i);
+            PRINT_FORMAT("Keys of the key encoder benchmark are %lu", bench_keys);
+            ++i;
+            continue;
+        } else if ("--generic_atomic_perc" == arg) {
+            generic_atomic_perc = stoul(val);
+            args.used_arg_and_val(i);
+            PRINT_FORMAT("Generic atomic perc is %"
+                                 PRIu8, generic_atomic_perc);
+            ++i;
+            continue;
+        } else if ("--atomic_op" == arg) {
+            atomic_op = val;
+            args.used_arg_and_val(i);
+            PRINT_FORMAT("Atomic op is %s", atomic_op.c_str());
+            ++i;
+            continue;
+        } else if ("--atomic_size" == arg) {
+            atomic_size = (u32) stoul(val);
+            args.used_arg_and_val(i);
+            PRINT_FORMAT("Atomic size is %u", atomic_size);
+            ++i;
+            continue;
+        } else if ("--atomic_keys" == arg) {
+            atomic_keys = (u32) stoul(val);
+            args.used_arg_and_val(i);
+            PRINT_FORMAT("Atomic keys is %u", atomic_keys);
+            ++i;
+            continue;
         } else if ("--generic_rp" == arg) {
             generic_rp = stoul(val);
             args.used_arg_and_val(i);
@@ -175,6 +370,27 @@ int fkvb_test_conf::parse_args(ParseArgs &args) {
             PRINT_FORMAT("Generic read ops is %u", generic_ops);
             ++i;
             continue;
+        } else if ("--generic_snapshot_perc" == arg) {
+            generic_snapshot_perc = stoul(val);
+            args.used_arg_and_val(i);
+            PRINT_FORMAT("Generic snapshot read perc is %"
+                                 PRIu8, generic_snapshot_perc);
+            ++i;
+            continue;
+        } else if ("--generic_no_conflict_perc" == arg) {
+            generic_no_conflict_perc = stoul(val);
+            args.used_arg_and_val(i);
+            PRINT_FORMAT("Generic no write conflict perc is %"
+                                 PRIu8, generic_no_conflict_perc);
+            ++i;
+            continue;
+        } else if ("--generic_conflict_perc" == arg) {
+            generic_conflict_perc = stoul(val);
+            args.used_arg_and_val(i);
+            PRINT_FORMAT("Generic explicit conflict range perc is %"
+                                 PRIu8, generic_conflict_perc);
+            ++i;
+            continue;
         } else if ("--dap" == arg) {
             key_gen = val;
             args.used_arg_and_val(i);
@@ -203,6 +419,12 @@ int fkvb_test_conf::parse_args(ParseArgs &args) {
             args.used_arg_and_val(i);
             PRINT_FORMAT("Value size generator is %s", value_size_gen.c_str());
             ++i;
+        } else if ("--value_compression" == arg) {
+            value_compression = stod(val);
+            args.used_arg_and_val(i);
+            PRINT_FORMAT("Value compression ratio is %f", value_compression);
+            ++i;
+            continue;
         } else if ("--xput" == arg) {
             xput_file = val;
             args.used_arg_and_val(i);
@@ -215,9 +437,10 @@ int fkvb_test_conf::parse_args(ParseArgs &args) {
             PRINT_FORMAT("Frequency is %u", frequency);
             ++i;
         } else if ("--key_size" == arg) {
-            key_size = (u32) stoul(val);
+            //A plain number is a constant size
+            key_size_gen = val.find_first_not_of("0123456789") == std::string::npos ? CONSTANT + val : val;
             args.used_arg_and_val(i);
-            PRINT_FORMAT("Key size is %u", key_size);
+            PRINT_FORMAT("Key size generator is %s", key_size_gen.c_str());
             ++i;
             continue;
         } else if ("--dur" == arg) {
@@ -274,11 +497,76 @@ int fkvb_test_conf::parse_args(ParseArgs &args) {
             args.used_arg_and_val(i);
             PRINT_FORMAT("grv_cache_ms  is %u", grv_cache_ms);
             ++i;
+        } else if ("--bulk_keys" == arg) {
+            bulk_keys = (u32) stoul(val);
+            args.used_arg_and_val(i);
+            PRINT_FORMAT("bulk_keys is %u", bulk_keys);
+            ++i;
+        } else if ("--bulk_bytes" == arg) {
+            bulk_bytes = (u32) stoul(val);
+            args.used_arg_and_val(i);
+            PRINT_FORMAT("bulk_bytes is %u", bulk_bytes);
+            ++i;
+        } else if ("--bulk_in_flight" == arg) {
+            bulk_in_flight = (u32) stoul(val);
+            args.used_arg_and_val(i);
+            PRINT_FORMAT("bulk_in_flight is %u", bulk_in_flight);
+            ++i;
+        } else if ("--grv_cache_shared" == arg) {
+            grv_cache_shared = stoul(val) != 0;
+            args.used_arg_and_val(i);
+            PRINT_FORMAT("grv_cache_shared is %d", grv_cache_shared);
+            ++i;
         } else if ("--sleep_time_us" == arg) {
             sleep_time_us = (u32) stoul(val);
             args.used_arg_and_val(i);
             PRINT_FORMAT("sleep_time_us  is %u", sleep_time_us);
             ++i;
+        } else if ("--target_rate" == arg) {
+            target_rate = (u32) stoul(val);
+            args.used_arg_and_val(i);
+            PRINT_FORMAT("target_rate is %u", target_rate);
+            ++i;
+        } else if ("--arrival" == arg) {
+            arrival = std::string(val);
+            args.used_arg_and_val(i);
+            PRINT_FORMAT("arrival is %s", arrival.c_str());
+            ++i;
+        } else if ("--tx_in_flight" == arg) {
+            tx_in_flight = (u32) stoul(val);
+            args.used_arg_and_val(i);
+            PRINT_FORMAT("tx_in_flight is %u", tx_in_flight);
+            ++i;
+        } else if ("--scan_mode" == arg) {
+            scan_mode = std::string(val);
+            args.used_arg_and_val(i);
+            PRINT_FORMAT("scan_mode is %s", scan_mode.c_str());
+            ++i;
+        } else if ("--scan_row_limit" == arg) {
+            scan_row_limit = (u32) stoul(val);
+            args.used_arg_and_val(i);
+            PRINT_FORMAT("scan_row_limit is %u", scan_row_limit);
+            ++i;
+        } else if ("--scan_byte_limit" == arg) {
+            scan_byte_limit = (u32) stoul(val);
+            args.used_arg_and_val(i);
+            PRINT_FORMAT("scan_byte_limit is %u", scan_byte_limit);
+            ++i;
+        } else if ("--scan_snapshot" == arg) {
+            scan_snapshot = stoul(val) != 0;
+            args.used_arg_and_val(i);
+            PRINT_FORMAT("scan_snapshot is %d", scan_snapshot);
+            ++i;
+        } else if ("--tx_reuse" == arg) {
+            tx_reuse = stoul(val) != 0;
+            args.used_arg_and_val(i);
+            PRINT_FORMAT("tx_reuse is %d", tx_reuse);
+            ++i;
+        } else if ("--start_at" == arg) {
+            start_at = (u64) stoull(val);
+            args.used_arg_and_val(i);
+            PRINT_FORMAT("start_at is %lu", start_at);
+            ++i;
         } else {
             PRINT_FORMAT(">>>> Unknown flag %s", arg.c_str());
             return 1;
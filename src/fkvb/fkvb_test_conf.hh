@@ -27,8 +27,10 @@ using namespace udepot;
 
 struct fkvb_test_conf : public KV_conf {
 
-#define DEFAULT_KEY_SIZE 16
+#define DEFAULT_KEY_SIZE_GEN "const16"
+#define KEY_SIZE_ZIPF_SKEW 0.99 //Of zipfx_y key sizes
 #define DEFAULT_VALUE_SIZE_GEN "const8"
+#define DEFAULT_VALUE_COMPRESSION 1.0
 #define DEFAULT_NUM_KEYS 10000
 #define DEFAULT_SCAN_LENGTH "const10"
 #define DEFAULT_READ_PERC 100
@@ -39,11 +41,30 @@ struct fkvb_test_conf : public KV_conf {
 #define DEFAULT_GENERIC_OPS 10
 #define DEFAULT_GENERIC_RP 0
 #define DEFAULT_RMW_PERC 0
+#define DEFAULT_ATOMIC_PERC 0
+#define DEFAULT_DELETE_PERC 0
+#define DEFAULT_CLEAR_RANGE_PERC 0
+#define DEFAULT_CLEAR_RANGE_LENGTH "const10"
+#define DEFAULT_REINSERT_DELAY 0
+#define DEFAULT_COUNT_RANGES 64
+#define DEFAULT_COUNT_WAIT_SEC 300
+#define DEFAULT_BENCH_KEYS 0
+#define MAX_COUNT_RANGES 100000
+#define DEFAULT_ATOMIC_OP "add"
+#define DEFAULT_ATOMIC_SIZE 8
+#define MAX_ATOMIC_SIZE 100000 //Max size of an FDB value
 #define DEFAULT_DAP UNIFORM
 #define DEFAULT_DURATION "sec60"
 #define DEFAULT_ADDITIONAL_ARGS ""
 #define DEFAULT_KEY_TYPE "fkvb"
 #define DEFAULT_IO "direct"
+#define DEFAULT_TARGET_RATE 0
+#define DEFAULT_ARRIVAL "poisson"
+#define DEFAULT_TX_IN_FLIGHT 1
+#define DEFAULT_SCAN_MODE "iterator"
+#define DEFAULT_BULK_KEYS 20
+#define DEFAULT_BULK_IN_FLIGHT 1
+#define MAX_BULK_BYTES 9000000 //FDB rejects transactions larger than 10MB (keys, values and overhead)
 
 
     fkvb_test_conf()
@@ -53,15 +74,19 @@ struct fkvb_test_conf : public KV_conf {
               insert_perc(DEFAULT_INSERT_PERC),
               rmw_perc(DEFAULT_RMW_PERC),
               scan_perc(DEFAULT_SCAN_PERC),
+              atomic_perc(DEFAULT_ATOMIC_PERC),
+              delete_perc(DEFAULT_DELETE_PERC),
+              clear_range_perc(DEFAULT_CLEAR_RANGE_PERC),
               generic_perc(DEFAULT_GENERIC_PERC),
               generic_rp(DEFAULT_GENERIC_RP),
               generic_ops(DEFAULT_GENERIC_OPS),
               num_keys(DEFAULT_NUM_KEYS),
               frequency(0),
               num_population_threads(1),
-              key_size(DEFAULT_KEY_SIZE),
+              key_size_gen(DEFAULT_KEY_SIZE_GEN),
               key_gen(UNIFORM),
               scan_len_gen(DEFAULT_SCAN_LENGTH),
+              clear_range_len_gen(DEFAULT_CLEAR_RANGE_LENGTH),
               value_size_gen(DEFAULT_VALUE_SIZE_GEN),
               xput_file(""),
               duration(DEFAULT_DURATION),
@@ -72,21 +97,84 @@ struct fkvb_test_conf : public KV_conf {
               instance_id(0), num_instances(1), key_type(DEFAULT_KEY_TYPE), additional_args(DEFAULT_ADDITIONAL_ARGS),
               config_file(""),
 	      sleep_time_us(0),
-	      grv_cache_ms(0){}
+	      target_rate(DEFAULT_TARGET_RATE),
+	      arrival(DEFAULT_ARRIVAL),
+	      tx_in_flight(DEFAULT_TX_IN_FLIGHT),
+	      start_at(0),
+	      scan_mode(DEFAULT_SCAN_MODE),
+	      scan_row_limit(0),
+	      scan_byte_limit(0),
+	      scan_snapshot(false),
+	      tx_reuse(true),
+	      bulk_keys(DEFAULT_BULK_KEYS),
+	      bulk_bytes(0),
+	      bulk_in_flight(DEFAULT_BULK_IN_FLIGHT),
+	      generic_snapshot_perc(0),
+	      generic_no_conflict_perc(0),
+	      generic_conflict_perc(0),
+	      generic_atomic_perc(0),
+	      atomic_op(DEFAULT_ATOMIC_OP),
+	      atomic_size(DEFAULT_ATOMIC_SIZE),
+	      atomic_keys(0),
+	      reinsert_delay(DEFAULT_REINSERT_DELAY),
+	      count_ranges(DEFAULT_COUNT_RANGES),
+	      count_wait_sec(DEFAULT_COUNT_WAIT_SEC),
+	      bench_keys(DEFAULT_BENCH_KEYS),
+	      value_compression(DEFAULT_VALUE_COMPRESSION),
+	      grv_cache_ms(0),
+	      grv_cache_shared(false){}
 
     ~fkvb_test_conf() {};
 
-    u8 read_perc, update_perc, insert_perc, rmw_perc, scan_perc, generic_perc, generic_rp;
-    u32 generic_ops, num_keys, frequency, num_population_threads, key_size;
-    std::string key_gen, scan_len_gen, value_size_gen, xput_file, duration, io;
+    u8 read_perc, update_perc, insert_perc, rmw_perc, scan_perc, atomic_perc, delete_perc, clear_range_perc,
+            generic_perc, generic_rp;
+    u32 generic_ops, num_keys, frequency, num_population_threads;
+    std::string key_size_gen, key_gen, scan_len_gen, clear_range_len_gen, value_size_gen, xput_file, duration, io;
     long seed;
     std::string load_barrier_file;
     bool load_barrier;
     u32 instance_id, num_instances;
     std::string key_type, additional_args, config_file;
     u32 sleep_time_us;	   
+    //Open-loop load generation: aggregate ops/s of the process (0 = closed loop) and inter-arrival distribution
+    u32 target_rate;
+    std::string arrival;
+    //Transactions that each thread keeps outstanding. If > 1, transactions are run asynchronously
+    u32 tx_in_flight;
+    //Wall-clock time (UNIX seconds) at which client threads start. 0 = as soon as all threads are ready
+    u64 start_at;
+    //Range reads: FDB streaming mode, limits per scan (0 = no limit) and isolation
+    std::string scan_mode;
+    u32 scan_row_limit, scan_byte_limit;
+    bool scan_snapshot;
+    //Reuse FDB transaction handles (fdb_transaction_reset) instead of creating one per op
+    bool tx_reuse;
+    //Population: max keys per transaction, target bytes (keys + values) per transaction (0 = only count keys),
+    //and transactions that each population thread keeps committing
+    u32 bulk_keys, bulk_bytes, bulk_in_flight;
+    //Generic transactions: percentage of reads that are snapshot reads, of writes that do not add a write conflict
+    //range, and of ops that add their key as an explicit conflict range
+    u8 generic_snapshot_perc, generic_no_conflict_perc, generic_conflict_perc;
+    //Atomic mutations: percentage of the writes of generic transactions that are atomic, mutation type, operand size,
+    //and number of keys (counters) they go to (0 = same keys as the other ops)
+    u8 generic_atomic_perc;
+    std::string atomic_op;
+    u32 atomic_size, atomic_keys;
+    //Ops after which a thread inserts back the keys it has deleted (OP_DELETE, OP_CLEAR_RANGE)
+    u32 reinsert_delay;
+    //Sub-ranges of the key space counted concurrently by the key checks after the population and the test
+    //(0 = no key checks)
+    u32 count_ranges;
+    //Max seconds that the key check after the population waits for the keys of the other instances
+    u32 count_wait_sec;
+    //If not 0, only run the microbenchmark of the key encoders, with this many keys per key type
+    u64 bench_keys;
+    //Target compression ratio (compressed size / size) of the values: 1 = incompressible
+    double value_compression;
     //FDB specific
     u32 grv_cache_ms=0;
+    //One GRV cache for the whole process, refreshed by a background thread, instead of one per thread
+    bool grv_cache_shared;
 
     int parse_args(ParseArgs &args) override final;
 
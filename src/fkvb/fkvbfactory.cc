@@ -13,6 +13,15 @@
 
 fkvb_factory::fkvb_factory() {}
 
+//The key encoder is a template parameter of FKVB, so it is picked here from the key type
+template<typename IO>
+static FKVB_g *build_for_key_type(KVOrdered <IO> *kv, fkvb_test_conf *conf) {
+    if (conf->key_type == "fkvb" || conf->key_type == "sharded_fkvb") {
+        return new FKVB<IO, decimal_key_encoder>(kv, conf);
+    }
+    return new FKVB<IO, random_key_encoder>(kv, conf);
+}
+
 FKVB_g *fkvb_factory::build_fkvb(fkvb_test_conf *conf) {
     switch (conf->type_m) {
         case KV_conf::KV_FDB: {
@@ -22,7 +31,7 @@ FKVB_g *fkvb_factory::build_fkvb(fkvb_test_conf *conf) {
                 return nullptr;
             }
             PRINT("Initing FDB");
-            return new FKVB<int>(FDB, conf);
+            return build_for_key_type<int>(FDB, conf);
         }
 
         case KV_conf::KV_DUMMY: {
@@ -32,7 +41,7 @@ FKVB_g *fkvb_factory::build_fkvb(fkvb_test_conf *conf) {
                 return nullptr;
             }
             PRINT_FORMAT("Initing %s", KV_conf::type_to_string(conf->type_m).c_str());
-            return new FKVB<int>(D, conf);
+            return build_for_key_type<int>(D, conf);
         }
 
         default: {
@@ -0,0 +1,178 @@
+/*
+ *  Copyright (c) 2021 International Business Machines
+ *  All rights reserved.
+ *
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Authors: Diego Didona (ddi@zurich.ibm.com),
+ *
+ */
+
+#ifndef HISTOGRAM_HH
+#define HISTOGRAM_HH
+
+#include <vector>
+#include <algorithm>
+#include <istream>
+#include <ostream>
+#include "types.hh"
+
+/*
+ * Log-linear (HDR-style) histogram of latencies, in ticks.
+ * Values in [0, 2^HIST_SUB_BUCKET_BITS) are recorded exactly. Larger values are split in powers of two, and each
+ * power of two in 2^(HIST_SUB_BUCKET_BITS-1) linear sub-buckets, so the relative error of any percentile is below
+ * 2^-(HIST_SUB_BUCKET_BITS-1) (< 1.6%). Values >= 2^HIST_MAX_BITS are recorded in the last bucket.
+ *
+ * Recording is O(1) and is meant to be done by a single thread on its own histogram, so no atomics are needed.
+ * Since all histograms share the same bucket layout, merging two histograms is exact (counts are just summed), so
+ * histograms of different threads, processes and hosts can be combined without losing precision.
+ */
+#define HIST_SUB_BUCKET_BITS 7
+#define HIST_MAX_BITS 44 //~2.3 hours at 2GHz
+#define HIST_HALF_BITS (HIST_SUB_BUCKET_BITS - 1)
+#define HIST_NUM_BUCKETS (((HIST_MAX_BITS - HIST_SUB_BUCKET_BITS) << HIST_HALF_BITS) + (1 << HIST_SUB_BUCKET_BITS))
+
+struct histogram {
+    //Allocated at the first sample, so that histograms of ops that are never issued cost nothing
+    std::vector<u64> counts;
+    u64 count;
+    u64 sum;
+    u64 min;
+    u64 max;
+
+    histogram() : count(0), sum(0), min(0), max(0) {
+    }
+
+    static inline u32 index_of(u64 value) {
+        if (value >> HIST_MAX_BITS) {
+            value = (1ULL << HIST_MAX_BITS) - 1;
+        }
+        const u32 msb = 63 - __builtin_clzll(value | ((1ULL << HIST_SUB_BUCKET_BITS) - 1));
+        const u32 bucket = msb - HIST_HALF_BITS;
+        return (bucket << HIST_HALF_BITS) + (u32) (value >> bucket);
+    }
+
+    //Lowest value that is recorded at index i
+    static inline u64 lowest_of(u32 i) {
+        if (i < (1U << HIST_SUB_BUCKET_BITS)) {
+            return i;
+        }
+        const u32 bucket = (i >> HIST_HALF_BITS) - 1;
+        return ((u64) ((i & ((1U << HIST_HALF_BITS) - 1)) + (1U << HIST_HALF_BITS))) << bucket;
+    }
+
+    //Highest value that is recorded at index i
+    static inline u64 highest_of(u32 i) {
+        if (i < (1U << HIST_SUB_BUCKET_BITS)) {
+            return i;
+        }
+        return lowest_of(i) + (1ULL << ((i >> HIST_HALF_BITS) - 1)) - 1;
+    }
+
+    void reset() {
+        if (count) {
+            std::fill(counts.begin(), counts.end(), 0);
+        }
+        count = sum = min = max = 0;
+    }
+
+    inline void add(u64 value) {
+        if (counts.empty()) {
+            counts.resize(HIST_NUM_BUCKETS);
+        }
+        counts[index_of(value)]++;
+        if (!count || value < min) {
+            min = value;
+        }
+        if (value > max) {
+            max = value;
+        }
+        count++;
+        sum += value;
+    }
+
+    void merge(const histogram &h) {
+        if (!h.count) {
+            return;
+        }
+        if (counts.empty()) {
+            counts.resize(HIST_NUM_BUCKETS);
+        }
+        for (u32 i = 0; i < HIST_NUM_BUCKETS; i++) {
+            counts[i] += h.counts[i];
+        }
+        if (!count || h.min < min) {
+            min = h.min;
+        }
+        if (h.max > max) {
+            max = h.max;
+        }
+        count += h.count;
+        sum += h.sum;
+    }
+
+    u64 get_avg() const {
+        return count ? sum / count : 0;
+    }
+
+    //Highest value equivalent to the perc-th percentile, clamped to the observed min and max
+    u64 get_percentile(double perc) const {
+        if (!count) {
+            return 0;
+        }
+        u64 rank = (u64) (perc * (double) count + 0.5);
+        if (!rank) {
+            rank = 1;
+        }
+        u64 seen = 0;
+        for (u32 i = 0; i < HIST_NUM_BUCKETS; i++) {
+            seen += counts[i];
+            if (seen >= rank) {
+                const u64 v = highest_of(i);
+                return v < min ? min : (v > max ? max : v);
+            }
+        }
+        return max;
+    }
+
+    /*
+     * Sparse text format: count sum min max num_entries idx:count ...
+     * Only non-empty buckets are written. The layout (HIST_SUB_BUCKET_BITS, HIST_MAX_BITS) is not, so it must be the
+     * same for the writer and the reader
+     */
+    void serialize(std::ostream &os) const {
+        u32 n = 0, i;
+        for (i = 0; count && i < HIST_NUM_BUCKETS; i++) {
+            n += counts[i] != 0;
+        }
+        os << count << " " << sum << " " << min << " " << max << " " << n;
+        for (i = 0; count && i < HIST_NUM_BUCKETS; i++) {
+            if (counts[i]) {
+                os << " " << i << ":" << counts[i];
+            }
+        }
+    }
+
+    //Returns false if the input is malformed
+    bool deserialize(std::istream &is) {
+        u32 n, idx;
+        u64 c;
+        char sep;
+        reset();
+        if (!(is >> count >> sum >> min >> max >> n)) {
+            return false;
+        }
+        if (n && counts.empty()) {
+            counts.resize(HIST_NUM_BUCKETS);
+        }
+        for (u32 i = 0; i < n; i++) {
+            if (!(is >> idx >> sep >> c) || sep != ':' || idx >= HIST_NUM_BUCKETS) {
+                return false;
+            }
+            counts[idx] += c;
+        }
+        return true;
+    }
+};
+
+#endif //HISTOGRAM_HH
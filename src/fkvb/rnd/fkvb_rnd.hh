@@ -132,5 +132,18 @@ struct shifted_zipf_io_pattern : io_pattern {
     }
 };
 
+/*
+ * Stateless counter-based generator: splitmix64 (the finalizer of the SplittableRandom of Java) maps a 64-bit counter
+ * to a random 64-bit value. The i-th value of a sequence is splitmix64(base + i * SPLITMIX64_GAMMA), so any element is
+ * computed in O(1), with no state to reseed
+ */
+#define SPLITMIX64_GAMMA 0x9E3779B97F4A7C15ULL
+
+static inline u64 splitmix64(u64 x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
 
 #endif //FKVB_RND_HH
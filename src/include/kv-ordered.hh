@@ -14,7 +14,43 @@
 #include "kv.hh"
 
 #include <vector>
+#include <string>
 #include <stdio.h>
+#include <stdint.h>
+
+/*
+ * Attempts of an operation, as seen by a backend that retries failed transactions.
+ * Backends that do not retry leave it empty
+ */
+struct kv_retry_stats {
+    uint32_t attempts; //Including the last one
+    uint32_t conflicts; //Attempts aborted because of a conflict with another transaction
+    uint64_t backoff_latency; //Ticks spent waiting before retrying
+    std::vector<int> errors; //Codes of the other failed attempts
+
+    kv_retry_stats() : attempts(0), conflicts(0), backoff_latency(0) {}
+
+    void reset() {
+        attempts = conflicts = 0;
+        backoff_latency = 0;
+        errors.clear();
+    }
+};
+
+/*
+ * Completion of an asynchronous operation. It can be invoked by a thread of the backend (e.g., the FDB network thread),
+ * so it must not block. begin_latency and commit_latency are in ticks
+ */
+typedef void (*kv_async_cb)(void *ctx, int rc, uint64_t begin_latency, uint64_t commit_latency,
+                            const kv_retry_stats &retries);
+
+/*
+ * Options of the ops of a generic transaction (flags[i] for the i-th op, flags can be nullptr).
+ * Backends that do not detect conflicts ignore the conflict options
+ */
+#define KV_OP_NO_CONFLICT 1 //Reads are snapshot reads, writes do not add a write conflict range
+#define KV_OP_ADD_CONFLICT 2 //The key is added as an explicit conflict range (of type read for reads, write for writes)
+#define KV_OP_ATOMIC 4 //The write is an atomic mutation (of the type configured in the backend) whose operand is the value
 
 // TODO: add iterator
 // TODO: add also the KVMbuff Iface to support 0copy
@@ -30,12 +66,56 @@ public:
                           std::vector<char *> &kv_ptrs // ptrs to kv pairs returned in kv_buff, in order
     ) = 0;
 
-    virtual int put_bulk(size_t numkv, char *k_ptr, size_t *k_sizes, char *v_ptrs, size_t *v_sizes) = 0;
+    //Keys are contiguous in k_ptr, the i-th value is v_ptrs[i]
+    virtual int put_bulk(size_t numkv, char *k_ptr, size_t *k_sizes, char **v_ptrs, size_t *v_sizes) = 0;
+
+    /*
+     * Deletes, in one transaction, the first (at most) max_keys keys >= start_key. The deleted keys are appended to
+     * deleted_keys, with their sizes in deleted_key_sizes, e.g., to insert them back later
+     */
+    virtual int clear_range(const char start_key[], size_t start_key_size, size_t max_keys, std::string &deleted_keys,
+                            std::vector<size_t> &deleted_key_sizes) = 0;
+
+    /*
+     * Counts the keys in the store. The boundaries split the key space in sub-ranges that are counted concurrently,
+     * so the closer they are to equal-sized, the faster the count. Their order does not matter
+     */
+    virtual unsigned long count_keys(const std::vector<std::string> &boundaries) const = 0;
 
     virtual void print_stats() = 0;
 
-    virtual int generic(int num_op, bool *rw, char *keys, size_t *key_sizes, char **put_values, size_t *put_value_sizes, char *get_buffer,
-                        size_t get_buffer_size, size_t *read_values, std::vector<char *> &read_values_ptr) = 0;
+    /*
+     * Runs num_op reads and writes (rw[i]) in one transaction. The values read are copied to get_buffer, which is grown
+     * if they do not fit: read_values is the number of bytes copied, and read_values_ptr[j] points to the value of the
+     * j-th read (nullptr if the key is missing)
+     */
+    virtual int generic(int num_op, bool *rw, uint8_t *flags, char *keys, size_t *key_sizes, char **put_values,
+                        size_t *put_value_sizes, std::vector<char> &get_buffer, size_t *read_values,
+                        std::vector<char *> &read_values_ptr) = 0;
+
+    /*
+     * Same as generic, but returns as soon as the transaction has been started. cb(ctx, ...) is called once the
+     * transaction has committed or failed. The buffers must stay valid until then.
+     * Backends without asynchronous support run the transaction synchronously and complete it before returning
+     */
+    virtual int generic_async(int num_op, bool *rw, uint8_t *flags, char *keys, size_t *key_sizes, char **put_values,
+                              size_t *put_value_sizes, kv_async_cb cb, void *ctx) {
+        std::vector<char> get_buffer;
+        std::vector<char *> read_values_ptr;
+        size_t read_values;
+        const int rc = generic(num_op, rw, flags, keys, key_sizes, put_values, put_value_sizes, get_buffer,
+                               &read_values, read_values_ptr);
+        cb(ctx, rc, 0, 0, kv_retry_stats());
+        return 0;
+    }
+
+    //Same as put_bulk, but returns as soon as the transaction has been started (see generic_async)
+    virtual int put_bulk_async(size_t numkv, char *k_ptr, size_t *k_sizes, char **v_ptrs, size_t *v_sizes,
+                               kv_async_cb cb, void *ctx) {
+        const int rc = put_bulk(numkv, k_ptr, k_sizes, v_ptrs, v_sizes);
+        cb(ctx, rc, 0, 0, kv_retry_stats());
+        return 0;
+    }
 };
 
 #endif //_KV_ORDERED_H_
@@ -25,7 +25,9 @@ THINK_TIME=0
 OPS_PER_TX=1
 RO_PERC=100
 GRV_CACHE_MS=0
+ATOMIC_PERC=0 #Percentage of the writes of a transaction that are atomic adds (counters) instead of sets
 TEST_SEC=60
+START_DELAY_SEC=10 #Seconds after the spawn of the clients at which the RUN starts. Must cover the client setup time
 #Nominal frequency in Hz of the CPU. It assumes all CPUs run at the same frequency and that any automatic scaling is disabled. E.g.,  a CPU with 2.9 GHz will have 2900000000 as value
 FREQ="2900000000"  
 
@@ -54,8 +56,10 @@ if [[ $1 == "LOAD" ]]; then
 	echo "Clients spawned. Now waiting for them to end"
 	wait
 elif [[ $1 == "RUN" ]]; then
+	#All the clients start measuring at the same wall-clock second
+	START_AT=$(( $(date +%s) + ${START_DELAY_SEC} ))
 	for c in $(seq 0 $(( ${NR_CLIENTS} - 1 )));do
-		LD_LIBRARY_PATH=${LB}:${LD_LIBRARY_PATH} ${EXEC} -f "DUMMY" --xput ${OUT_DIR}/${c}.run.xput.out  --freq ${FREQ} ${CLNT_KNOBS}  --seed ${SEED} -u 13 --t_population 0 -t ${NR_THREADS} --num_keys ${NUM_KEYS} --key_size ${KEY_SIZE} --value_size const${VALUE_SIZE} --key_type random --config_file ${CLUSTER_FILE} --id ${c} --dap uniform --read_perc 0 --update_perc 0 --generic_perc 100 --generic_rp ${RO_PERCENTAGE} --generic_ops ${OPS_PER_TX} --grv_cache_ms ${GRV_CACHE_MS} --dur sec${TEST_SEC} --key_type random  --sleep_time_us ${THINK_TIME}  2>${OUT_DIR}/${c}.run.err | tee ${OUT_DIR}/${c}.run.out &
+		LD_LIBRARY_PATH=${LB}:${LD_LIBRARY_PATH} ${EXEC} -f "DUMMY" --xput ${OUT_DIR}/${c}.run.xput.out  --freq ${FREQ} ${CLNT_KNOBS}  --seed ${SEED} -u 13 --t_population 0 -t ${NR_THREADS} --num_keys ${NUM_KEYS} --key_size ${KEY_SIZE} --value_size const${VALUE_SIZE} --key_type random --config_file ${CLUSTER_FILE} --id ${c} --dap uniform --read_perc 0 --update_perc 0 --generic_perc 100 --generic_rp ${RO_PERCENTAGE} --generic_ops ${OPS_PER_TX} --grv_cache_ms ${GRV_CACHE_MS} --generic_atomic_perc ${ATOMIC_PERC} --dur sec${TEST_SEC} --key_type random  --sleep_time_us ${THINK_TIME} --start_at ${START_AT}  2>${OUT_DIR}/${c}.run.err | tee ${OUT_DIR}/${c}.run.out &
 	done
 	echo "Clients spawned. Now waiting for them to end"
 	wait
@@ -42,14 +42,58 @@ def main(argv):
     p99_generic_begin = {}
     p99_generic_commit = {}
     p99_generic_total = {}
+    # Latency of all ops: measured (service time) and corrected for coordinated omission
+    co_names = ["p50_service", "p99_service", "p999_service", "p50_corrected", "p99_corrected", "p999_corrected"]
+    co = {}
+    # Wall-clock second (UNIX time) of each row. Rows of all threads covering the same wall-clock second are merged
+    wall_col = 30
+    # Per-process aggregate lines start with "proc" (or "late" for corrections): this script averages the per-thread lines
+    lines = [line for line in file.readlines() if line.split() and line.split()[0] not in ("proc", "late")]
+    walls = [int(line.split()[wall_col]) for line in lines if len(line.split()) > wall_col]
+    first_wall = min(walls) if walls else 0
+    wall = {}
+    # Range reads: avg/p50/p99 latency (averaged over threads), rows and bytes returned (summed over threads)
+    scan_col = 31
+    scan_lat_names = ["avg_scan", "p50_scan", "p99_scan"]
+    scan_lat = {}
+    scan_rows = {}
+    scan_bytes = {}
+    # Tail latency of generic operations, from the latency histograms
+    tail_col = 36
+    tail_names = ["p999_generic", "p9999_generic"]
+    tail = {}
+    # Cost of getting a transaction handle (and releasing it, for synchronous transactions). Column 38 is the number
+    # of threads of the row
+    alloc_col = 39
+    alloc_names = ["avg_tx_alloc", "p50_tx_alloc", "p99_tx_alloc"]
+    alloc = {}
+    # Read versions requested to the cluster (summed over threads), i.e., not served by the GRV cache
+    grv_col = 42
+    grv_requests = {}
+    # Attempts whose read version was rejected (transaction_too_old or future_version, summed over threads)
+    grv_stale = {}
+    # Attempts, conflicts and other errors of all ops, and time spent in the backoff before retrying (summed over threads)
+    retry_col = 44
+    retry_names = ["attempts", "conflicts", "errors", "backoff_us"]
+    retry = {}
+    # Bytes (keys + values) written by the population (summed over threads)
+    load_col = 48
+    load_bytes = {}
+    delete_col = 49
+    deleted_keys = {}
+    reinserted_keys = {}
     t_count = 0
-    for line in file:
+    for line in lines:
         split = line.split()
         t = float(split[0])
         if t + 1 > t_count:  # threads start at 0
             t_count = t + 1
         # convert seconds to int so that then sorting is on N (1 2 3) and not on lexicographic order (1 10 100...)
-        s = int(split[1])
+        if len(split) > wall_col:
+            s = int(split[wall_col]) - first_wall
+            wall[s] = int(split[wall_col])
+        else:
+            s = int(split[1])
 
         x = split[2]
         l = split[3]
@@ -77,6 +121,18 @@ def main(argv):
             p99_generic_begin[s] = 0.
             p99_generic_commit[s] = 0.
             p99_generic_total[s] = 0.
+            co[s] = [0.] * len(co_names)
+            scan_lat[s] = [0.] * len(scan_lat_names)
+            scan_rows[s] = 0
+            scan_bytes[s] = 0
+            tail[s] = [0.] * len(tail_names)
+            alloc[s] = [0.] * len(alloc_names)
+            grv_requests[s] = 0
+            grv_stale[s] = 0
+            retry[s] = [0.] * len(retry_names)
+            load_bytes[s] = 0
+            deleted_keys[s] = 0
+            reinserted_keys[s] = 0
 
         xputs[s] = xputs[s] + float(x)
         cumul[s] = cumul[s] + float(l)
@@ -103,13 +159,41 @@ def main(argv):
             p99_generic_begin[s] = p99_generic_begin[s] + float(split[21])
             p99_generic_commit[s] = p99_generic_commit[s] + float(split[22])
             p99_generic_total[s] = p99_generic_total[s] + float(split[23])
+        if len(split) > 24:
+            for c in range(len(co_names)):
+                co[s][c] = co[s][c] + float(split[24 + c])
+        if len(split) > scan_col:
+            for c in range(len(scan_lat_names)):
+                scan_lat[s][c] = scan_lat[s][c] + float(split[scan_col + c])
+            scan_rows[s] = scan_rows[s] + int(split[scan_col + 3])
+            scan_bytes[s] = scan_bytes[s] + int(split[scan_col + 4])
+        if len(split) > tail_col:
+            for c in range(len(tail_names)):
+                tail[s][c] = tail[s][c] + float(split[tail_col + c])
+        if len(split) > alloc_col:
+            for c in range(len(alloc_names)):
+                alloc[s][c] = alloc[s][c] + float(split[alloc_col + c])
+        if len(split) > grv_col:
+            grv_requests[s] = grv_requests[s] + int(split[grv_col])
+        if len(split) > grv_col + 1:
+            grv_stale[s] = grv_stale[s] + int(split[grv_col + 1])
+        if len(split) > retry_col:
+            for c in range(len(retry_names)):
+                retry[s][c] = retry[s][c] + float(split[retry_col + c])
+        if len(split) > load_col:
+            load_bytes[s] = load_bytes[s] + int(split[load_col])
+        if len(split) > delete_col + 1:
+            deleted_keys[s] = deleted_keys[s] + int(split[delete_col])
+            reinserted_keys[s] = reinserted_keys[s] + int(split[delete_col + 1])
     file.close()
 
     file = open(file_out, "w")
     file.write("#Second Xput avg_generic p50_insert p99_insert p50_generic p99_generic "
                "avg_init p50_init p99_init avg_commit p50_commit p99_commit avg_update p50_update p99_update "
                "p50_generic_b p50_generic_c p50_generic_total "
-               "p99_generic_b p99_generic_c p99_generic_total\n")
+               "p99_generic_b p99_generic_c p99_generic_total " + " ".join(co_names) + " wall_sec " +
+               " ".join(scan_lat_names) + " scan_rows scan_bytes " + " ".join(tail_names) + " " +
+               " ".join(alloc_names) + " grv_requests grv_stale " + " ".join(retry_names) + " load_MBps deleted_keys reinserted_keys\n")
     for s in sorted(xputs):
         avg = float((cumul[s] / tics_per_usec) / xputs[s]) if xputs[s] > 0 else 0
         i50 = (p50_insert[s] / tics_per_usec) / t_count
@@ -145,14 +229,26 @@ def main(argv):
             cg99 = 0
             tg99 = 0
 
+        co_avg = [(c / tics_per_usec) / t_count for c in co[s]]
+
         file.write(
-            "{0} {1} {2} {3} {4} {5} {6} {7} {8} {9} {10} {11} {12} {13} {14} {15} {16} {17} {18} {19} {20} {21}\n".format(
+            "{0} {1} {2} {3} {4} {5} {6} {7} {8} {9} {10} {11} {12} {13} {14} {15} {16} {17} {18} {19} {20} {21} ".format(
                 s, xputs[s], avg,
                 i50, i99, g50, g99,
                 initavg, init50, init99,
                 commitavg, commit50, commit99,
                 updateavg, update50, update99,
                 bg50, cg50, tg50, bg99, cg99, tg99))
+        scan_avg = [(c / tics_per_usec) / t_count for c in scan_lat[s]]
+        file.write(" ".join(str(c) for c in co_avg) + " {0} ".format(wall.get(s, 0)))
+        tail_avg = [(c / tics_per_usec) / t_count for c in tail[s]]
+        file.write(" ".join(str(c) for c in scan_avg) + " {0} {1} ".format(scan_rows[s], scan_bytes[s]))
+        alloc_avg = [(c / tics_per_usec) / t_count for c in alloc[s]]
+        file.write(" ".join(str(c) for c in tail_avg) + " ")
+        file.write(" ".join(str(c) for c in alloc_avg) + " {0} {1} ".format(grv_requests[s], grv_stale[s]))
+        file.write("{0} {1} {2} {3} ".format(int(retry[s][0]), int(retry[s][1]), int(retry[s][2]),
+                                             retry[s][3] / tics_per_usec))
+        file.write("{0} {1} {2}\n".format(load_bytes[s] / 1e6, deleted_keys[s], reinserted_keys[s]))
     file.flush()
 
 